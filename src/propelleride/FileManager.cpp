@@ -58,7 +58,7 @@ void FileManager::open()
 {
     QString dir = QDir(tabToolTip(currentIndex())).path();
     QStringList fileNames = QFileDialog::getOpenFileNames(this,
-                tr("Open File"), dir, "Spin Files (*.spin);;All Files (*)");
+                tr("Open File"), dir, "Spin Files (*.spin);;Assembly Files (*.pasm);;C Files (*.c *.h);;All Files (*)");
 
     for (int i = 0; i < fileNames.size(); i++)
         if (!fileNames.at(i).isEmpty())
@@ -117,6 +117,9 @@ void FileManager::openFile(const QString & fileName)
     else
         index = newFile();
 
+    // the name picks the language, set it before the text is colored
+    getEditor(index)->setFileName(QFileInfo(fileName).canonicalFilePath());
+
     QTextStream in(&file);
     in.setAutoDetectUnicode(true);
     in.setCodec("UTF-8");
@@ -202,6 +205,7 @@ void FileManager::saveFile(const QString & fileName, int index)
 
     setTabToolTip(index,QFileInfo(fileName).canonicalFilePath());
     setTabText(index,QFileInfo(fileName).fileName());
+    getEditor(index)->setFileName(QFileInfo(fileName).canonicalFilePath());
     getEditor(index)->saveContent();
     fileChanged();
     emit sendMessage(tr("File saved successfully: %1").arg(fileName));
@@ -1,101 +1,170 @@
 #include "Highlighter.h"
 
-Highlighter::Highlighter(QTextDocument *parent)
+Highlighter::Highlighter(QTextDocument *parent, const QString & language)
     : QSyntaxHighlighter(parent)
 {
     currentTheme = &Singleton<ColorScheme>::Instance();
-    highlight();
+    lexer = Singleton<LanguageRegistry>::Instance().lexer(language);
+    setFormats();
+
+    firstVisible = 0;
+    lastVisible = -1;
+    pendingFrom = -1;
+    forcedBlock = -1;
+    sliceStarted = false;
+
+    idleTimer.setSingleShot(true);
+    idleTimer.setInterval(0);
+    connect(&idleTimer, SIGNAL(timeout()), this, SLOT(highlightPending()));
+    connect(parent, SIGNAL(contentsChange(int,int,int)), this, SLOT(contentsChange(int,int,int)));
 }
 
-void Highlighter::addRules(QStringList rules,
-        QTextCharFormat format)
+void Highlighter::setLanguage(const QString & language)
 {
-    HighlightingRule rule;
-    rule.format = format;
+    QSharedPointer<const SyntaxLexer> l = Singleton<LanguageRegistry>::Instance().lexer(language);
+    if (l == lexer)
+        return;
+
+    lexer = l;
+    rehighlight();
+}
+
+void Highlighter::updateColors()
+{
+    setFormats();
+    rehighlight();
+}
+
+void Highlighter::setVisibleBlocks(int first, int last)
+{
+    firstVisible = first;
+    lastVisible = last;
+
+    if (pendingFrom >= 0 && pendingFrom <= last)
+        idleTimer.start();
+}
+
+/*
+ * lines removed above the pending blocks give them lower numbers, so
+ * the search for them starts at the edit at the latest.
+ */
+void Highlighter::contentsChange(int position, int /* removed */, int /* added */)
+{
+    if (pendingFrom < 0)
+        return;
+
+    int n = document()->findBlock(position).blockNumber();
+    if (n >= 0 && n < pendingFrom)
+        pendingFrom = n;
+}
+
+/* the budget is counted from the first block of an event loop turn */
+void Highlighter::endSlice()
+{
+    sliceStarted = false;
+}
+
+void Highlighter::highlightNow(const QTextBlock & block)
+{
+    forcedBlock = block.blockNumber();
+    rehighlightBlock(block);
+    forcedBlock = -1;
+}
+
+void Highlighter::highlightPending()
+{
+    QTextDocument * doc = document();
+    if (!doc || pendingFrom < 0)
+        return;
+
+    QElapsedTimer timer;
+    timer.start();
 
-    foreach(QString r, rules)
+    int from = pendingFrom;
+    pendingFrom = -1;
+
+    // what is on screen may have been scrolled to
+    QTextBlock block = doc->findBlockByNumber(firstVisible);
+    for (int n = firstVisible; block.isValid() && n <= lastVisible; n++)
     {
-        rule.pattern = QRegExp(r,Qt::CaseInsensitive);
-        highlightingRules.append(rule);
+        if (block.userState() == -1)
+            highlightNow(block);
+        block = block.next();
     }
+
+    block = doc->findBlockByNumber(from);
+    while (block.isValid() && timer.elapsed() < BUDGET)
+    {
+        if (block.userState() == -1)
+            highlightNow(block);
+        block = block.next();
+    }
+
+    if (block.isValid())
+    {
+        int n = block.blockNumber();
+        pendingFrom = pendingFrom < 0 ? n : qMin(pendingFrom, n);
+    }
+    if (pendingFrom >= 0)
+        idleTimer.start();
 }
 
+/*
+ * the block state is the lexer state, -1 if the block is pending or
+ * wasn't highlighted yet.
+ */
 void Highlighter::highlightBlock(const QString &text)
 {
-    int rules = 0;
-    foreach (const HighlightingRule &rule, highlightingRules) {
-        rules++;
-        QRegExp expression(rule.pattern);
-        int index = expression.indexIn(text);
-        while (index >= 0) {
-            int length = expression.matchedLength();
-            if(length == 0)
-                break;
-            setFormat(index, length, rule.format);
-            index = expression.indexIn(text, index + length);
-        }
+    if (!sliceStarted)
+    {
+        sliceStarted = true;
+        slice.start();
+        QTimer::singleShot(0, this, SLOT(endSlice()));
     }
-    if(rules == 0)
+
+    int number = currentBlock().blockNumber();
+    if (slice.elapsed() >= BUDGET && number != forcedBlock
+            && (number < firstVisible || number > lastVisible))
+    {
+        setCurrentBlockState(-1);
+        if (pendingFrom < 0 || number < pendingFrom)
+            pendingFrom = number;
+        idleTimer.start();
         return;
+    }
 
-    setCurrentBlockState(0);
-
-    int startIndex = 0;
-    if (previousBlockState() != 1)
-        startIndex = commentStartExpression.indexIn(text);
-
-    while (startIndex >= 0) {
-        int endIndex = commentEndExpression.indexIn(text, startIndex);
-        int commentLength;
-        if (endIndex == -1) {
-            setCurrentBlockState(1);
-            commentLength = text.length() - startIndex;
-        } else {
-            commentLength = endIndex - startIndex
-                            + commentEndExpression.matchedLength();
-        }
-        setFormat(startIndex, commentLength, multiLineCommentFormat);
-        startIndex = commentStartExpression.indexIn(text, startIndex + commentLength);
+    spans.resize(0);
+    int state = lexer->lex(text, qMax(previousBlockState(), 0), spans);
+
+    for (int i = 0; i < spans.count(); i++)
+    {
+        const SyntaxLexer::Span & s = spans.at(i);
+        setFormat(s.start, s.length, formats[s.style]);
     }
+
+    setCurrentBlockState(state);
 }
 
-void Highlighter::highlight()
+void Highlighter::setFormats()
 {
-    HighlightingRule rule;
-
-    Language lang = Language();
-
     // numbers
-    numberFormat.setForeground(currentTheme->getColor(ColorScheme::SyntaxNumbers));
-    numberFormat.setFontWeight(QFont::Normal);
-    addRules(lang.listNumbers(),numberFormat);
+    formats[SyntaxLexer::S_NUMBER].setForeground(currentTheme->getColor(ColorScheme::SyntaxNumbers));
+    formats[SyntaxLexer::S_NUMBER].setFontWeight(QFont::Normal);
 
-    // functions before keywords if names are keywords
-    functionFormat.setForeground(currentTheme->getColor(ColorScheme::SyntaxFunctions));
-    functionFormat.setFontWeight(QFont::Normal);
-    addRules(lang.listFunctions(),functionFormat);
+    // function names
+    formats[SyntaxLexer::S_FUNCTION].setForeground(currentTheme->getColor(ColorScheme::SyntaxFunctions));
+    formats[SyntaxLexer::S_FUNCTION].setFontWeight(QFont::Normal);
 
-    // handle Spin keywords
-    keywordFormat.setForeground(currentTheme->getColor(ColorScheme::SyntaxKeywords));
-    keywordFormat.setFontWeight(QFont::Bold);
-    addRules(lang.listKeywords(),keywordFormat);
-    addRules(lang.listOperators(),keywordFormat);
+    // keywords and operators
+    formats[SyntaxLexer::S_KEYWORD].setForeground(currentTheme->getColor(ColorScheme::SyntaxKeywords));
+    formats[SyntaxLexer::S_KEYWORD].setFontWeight(QFont::Bold);
+    formats[SyntaxLexer::S_OPERATOR] = formats[SyntaxLexer::S_KEYWORD];
 
     // quoted strings
-    quotationFormat.setForeground(currentTheme->getColor(ColorScheme::SyntaxQuotes));
-    quotationFormat.setFontWeight(QFont::Normal);
-    addRules(lang.listStrings(),quotationFormat);
-
-    // single line comments
-    singleLineCommentFormat.setForeground(currentTheme->getColor(ColorScheme::SyntaxComments));
-    singleLineCommentFormat.setFontWeight(QFont::Normal);
-    addRules(lang.listComments(),singleLineCommentFormat);
-
-    // multilineline comments
-    multiLineCommentFormat.setForeground(currentTheme->getColor(ColorScheme::SyntaxComments));
-    multiLineCommentFormat.setFontWeight(QFont::Normal);
-    commentStartExpression = QRegExp("{",Qt::CaseInsensitive,QRegExp::Wildcard);
-    commentEndExpression = QRegExp("*}",Qt::CaseInsensitive,QRegExp::Wildcard);
+    formats[SyntaxLexer::S_STRING].setForeground(currentTheme->getColor(ColorScheme::SyntaxQuotes));
+    formats[SyntaxLexer::S_STRING].setFontWeight(QFont::Normal);
 
+    // single and multi line comments
+    formats[SyntaxLexer::S_COMMENT].setForeground(currentTheme->getColor(ColorScheme::SyntaxComments));
+    formats[SyntaxLexer::S_COMMENT].setFontWeight(QFont::Normal);
 }
-
@@ -2,51 +2,75 @@
 
 #include <QSyntaxHighlighter>
 #include <QTextCharFormat>
+#include <QTextBlock>
+#include <QSharedPointer>
+#include <QElapsedTimer>
+#include <QTimer>
 #include <QString>
-#include <QStringList>
-#include <QRegExp>
 #include <QVector>
 #include <QFont>
 #include <Qt>
 
-#include "Language.h"
 #include "Preferences.h"
 #include "ColorScheme.h"
+#include "LanguageRegistry.h"
+#include "SyntaxLexer.h"
 
+/*
+ * Colors the blocks on screen first and the rest when the IDE is idle.
+ *
+ * Each turn of the event loop may spend BUDGET milliseconds on blocks
+ * that aren't visible. A block left over gets the state -1 and no
+ * formats, and a zero timer colors the pending blocks in order, one
+ * budget at a time. Opening a big file or recoloring it after a theme
+ * change so only costs the blocks on screen right away.
+ *
+ * A visible block after a pending one is colored as if no comment was
+ * open. Coloring the pending block later changes its state, and that
+ * makes QSyntaxHighlighter color the visible one again.
+ */
 class Highlighter : public QSyntaxHighlighter
 {
     Q_OBJECT
 
 private:
+    enum { BUDGET = 10 };
+
     ColorScheme * currentTheme;
+    QSharedPointer<const SyntaxLexer> lexer;
+
+    QTextCharFormat formats[SyntaxLexer::S_STYLES];
+    QVector<SyntaxLexer::Span> spans;
+
+    int firstVisible;
+    int lastVisible;
+    int pendingFrom;        /* the first block that may be pending, -1 if none */
+    int forcedBlock;        /* colored even if the budget is spent */
+
+    QElapsedTimer slice;
+    bool sliceStarted;
+    QTimer idleTimer;
+
+    void setFormats();
+    void highlightNow(const QTextBlock & block);
+
+private slots:
+    void contentsChange(int position, int removed, int added);
+    void endSlice();
+    void highlightPending();
 
 public:
-    Highlighter(QTextDocument *parent);
+    Highlighter(QTextDocument *parent, const QString & language);
 
-    void addRules(QStringList rules,
-            QTextCharFormat format);
+    /* color with the rules of another language file */
+    void setLanguage(const QString & language);
 
-    void highlight();
+    /* take the colors of the current theme and color the document again */
+    void updateColors();
+
+    /* the block numbers on screen, these are never left pending */
+    void setVisibleBlocks(int first, int last);
 
 protected:
     void highlightBlock(const QString &text);
-
-    struct HighlightingRule
-    {
-        QRegExp pattern;
-        QTextCharFormat format;
-    };
-    QVector<HighlightingRule> highlightingRules;
-
-    QRegExp commentStartExpression;
-    QRegExp commentEndExpression;
-
-    QTextCharFormat keywordFormat;
-    QTextCharFormat preprocessorFormat;
-    QTextCharFormat classFormat;
-    QTextCharFormat singleLineCommentFormat;
-    QTextCharFormat multiLineCommentFormat;
-    QTextCharFormat quotationFormat;
-    QTextCharFormat functionFormat;
-    QTextCharFormat numberFormat;
 };
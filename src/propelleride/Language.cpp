@@ -53,6 +53,7 @@ QJsonObject Language::loadLanguage(QString filename)
     QJsonDocument d = QJsonDocument::fromJson(val.toUtf8());
     lang = d.object();
     syntax = lang["syntax"].toObject();
+    extensions = buildWordList(lang["ext"].toArray());
 
     case_sensitive = false;
     enable_blocks = false;
@@ -61,9 +62,11 @@ QJsonObject Language::loadLanguage(QString filename)
     functions = buildWordList(syntax["function"].toArray());
     comments = buildWordList(syntax["comment"].toArray());
     strings = buildWordList(syntax["string"].toArray());
+    blockComments = buildWordList(syntax["block_comment"].toArray());
 
     enable_blocks = syntax["enable_blocks"].toArray().first().toBool();
     case_sensitive = syntax["case_sensitive"].toBool();
+    nested_comments = syntax["nested_comments"].toBool();
     escape_char = syntax["escape"].toString();
 
     modes = syntax["mode"].toObject();
@@ -117,7 +120,40 @@ QStringList Language::listFunctions()
     return functions;
 }
 
+/* "open close" pairs, these comments may span lines */
+QStringList Language::listBlockComments()
+{
+    return blockComments;
+}
+
+QStringList Language::listExtensions()
+{
+    return extensions;
+}
+
+/* the pattern of an escape sequence in strings, empty if there are none */
+QString Language::escape()
+{
+    return escape_char;
+}
+
+bool Language::caseSensitive()
+{
+    return case_sensitive;
+}
+
+/* block comments nest in comments of the same kind */
+bool Language::nestedComments()
+{
+    return nested_comments;
+}
+
 Language::Language() 
 {
     loadLanguage("languages/spin.json");
 }
+
+Language::Language(QString filename)
+{
+    loadLanguage(filename);
+}
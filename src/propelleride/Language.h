@@ -14,6 +14,7 @@ private:
 
     bool case_sensitive;
     bool enable_blocks;
+    bool nested_comments;
     QString escape_char;
 
     QStringList keywords;
@@ -22,6 +23,8 @@ private:
     QStringList strings;
     QStringList functions;
     QStringList comments;
+    QStringList blockComments;
+    QStringList extensions;
 
     QStringList matchWholeWord(QStringList list);
     QStringList buildWordList(QJsonArray keyarray);
@@ -35,5 +38,11 @@ public:
     QStringList listStrings();
     QStringList listComments();
     QStringList listFunctions();
+    QStringList listBlockComments();
+    QStringList listExtensions();
+    QString escape();
+    bool caseSensitive();
+    bool nestedComments();
     Language();
+    Language(QString filename);
 };
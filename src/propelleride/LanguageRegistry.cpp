@@ -0,0 +1,57 @@
+#include "LanguageRegistry.h"
+
+#include <QDir>
+#include <QFileInfo>
+
+#include "Language.h"
+
+static const char * const defaultLanguage = "languages/spin.json";
+
+LanguageRegistry::LanguageRegistry()
+{
+    loaded = false;
+}
+
+void LanguageRegistry::loadLanguages()
+{
+    loaded = true;
+
+    QDir dir("languages");
+    foreach (const QString & name, dir.entryList(QStringList() << "*.json", QDir::Files, QDir::Name))
+    {
+        QString file = "languages/" + name;
+        Language lang(file);
+        lexers.insert(file, QSharedPointer<const SyntaxLexer>(new SyntaxLexer(lang)));
+
+        foreach (const QString & ext, lang.listExtensions())
+        {
+            if (!extensions.contains(ext.toLower()))
+                extensions.insert(ext.toLower(), file);
+        }
+    }
+}
+
+QString LanguageRegistry::languageFile(const QString & fileName)
+{
+    if (!loaded)
+        loadLanguages();
+
+    QString ext = QFileInfo(fileName).suffix().toLower();
+    return extensions.value(ext, defaultLanguage);
+}
+
+QSharedPointer<const SyntaxLexer> LanguageRegistry::lexer(const QString & languageFile)
+{
+    if (!loaded)
+        loadLanguages();
+
+    QHash<QString, QSharedPointer<const SyntaxLexer> >::const_iterator i = lexers.constFind(languageFile);
+    if (i != lexers.constEnd())
+        return i.value();
+
+    // a file that can't be read is kept too, it colors nothing
+    Language lang(languageFile);
+    QSharedPointer<const SyntaxLexer> compiled(new SyntaxLexer(lang));
+    lexers.insert(languageFile, compiled);
+    return compiled;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <QHash>
+#include <QSharedPointer>
+#include <QString>
+
+#include "SyntaxLexer.h"
+#include "templates/Singleton.h"
+
+/*
+ * The compiled rules of the language files, shared by all editors.
+ *
+ * The first lookup reads and compiles every file in languages/ and
+ * maps the extensions listed in their "ext" arrays to them. A lexer
+ * is kept until the IDE quits. It never changes once it is compiled,
+ * so all highlighters of a language hold the same one.
+ *
+ * Only used on the GUI thread.
+ */
+class LanguageRegistry
+{
+public:
+    LanguageRegistry();
+
+    /* the language file for the extension of fileName, Spin if none has it */
+    QString languageFile(const QString & fileName);
+
+    QSharedPointer<const SyntaxLexer> lexer(const QString & languageFile);
+
+private:
+    void loadLanguages();
+
+    bool loaded;
+    QHash<QString, QString> extensions;     /* lower case extension to language file */
+    QHash<QString, QSharedPointer<const SyntaxLexer> > lexers;
+};
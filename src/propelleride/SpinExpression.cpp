@@ -0,0 +1,333 @@
+#include "SpinExpression.h"
+
+#include <math.h>
+
+/* the binary operators, lowest level binds tightest */
+typedef struct {
+    const char * op;
+    int level;
+} BinaryOperator;
+
+static const BinaryOperator spin_binary[] = {
+    { "->", 3 }, { "<-", 3 }, { ">>", 3 }, { "<<", 3 }, { "~>", 3 }, { "><", 3 },
+    { "&", 4 },
+    { "|", 5 }, { "^", 5 },
+    { "*", 6 }, { "**", 6 }, { "/", 6 }, { "//", 6 },
+    { "+", 7 }, { "-", 7 },
+    { "#>", 8 }, { "<#", 8 },
+    { "<", 9 }, { ">", 9 }, { "<>", 9 }, { "==", 9 }, { "=<", 9 }, { "=>", 9 },
+    { NULL, 0 }
+};
+
+/* NOT is unary at level 10, AND and OR are words */
+#define LEVEL_NOT   10
+#define LEVEL_AND   11
+#define LEVEL_OR    12
+#define OP_AND      -1
+#define OP_OR       -2
+
+/* built in constants */
+typedef struct {
+    const char * name;
+    qint32 value;
+} BuiltIn;
+
+static const BuiltIn spin_constants[] = {
+    { "true", -1 }, { "false", 0 },
+    { "posx", 0x7FFFFFFF }, { "negx", (qint32) 0x80000000 },
+    { "rcfast", 0x001 }, { "rcslow", 0x002 }, { "xinput", 0x004 },
+    { "xtal1", 0x008 }, { "xtal2", 0x010 }, { "xtal3", 0x020 },
+    { "pll1x", 0x040 }, { "pll2x", 0x080 }, { "pll4x", 0x100 },
+    { "pll8x", 0x200 }, { "pll16x", 0x400 },
+    { NULL, 0 }
+};
+
+SpinExpression::SpinExpression(const SpinTokenizer & tok, Resolver & resolver)
+    : tok(tok), resolver(resolver), n(0)
+{
+}
+
+SpinExpression::Value SpinExpression::invalid()
+{
+    Value v = { false, false, 0, 0 };
+    return v;
+}
+
+SpinExpression::Value SpinExpression::integer(qint32 i)
+{
+    Value v = { true, false, i, 0 };
+    return v;
+}
+
+SpinExpression::Value SpinExpression::real(float f)
+{
+    Value v = { true, true, 0, f };
+    return v;
+}
+
+SpinExpression::Value SpinExpression::evaluate(const QString & expression, Resolver & resolver)
+{
+    SpinTokenizer tok(expression);
+    if (!tok.nextLine())
+        return invalid();
+
+    SpinExpression e(tok, resolver);
+    Value v = e.expression(LEVEL_OR);
+
+    // anything left over means it wasn't an expression after all
+    if (e.n != tok.count())
+        return invalid();
+    return v;
+}
+
+QString SpinExpression::toString(const Value & value)
+{
+    if (!value.valid)
+        return QString();
+    if (value.real)
+        return QString::number(value.number, 'g', 8);
+    return QString::number(value.integer);
+}
+
+/* the level of binary operator n, 0 if it isn't one */
+int SpinExpression::binaryLevel(int n) const
+{
+    if (n >= tok.count())
+        return 0;
+    if (tok.isName(n, "and"))
+        return LEVEL_AND;
+    if (tok.isName(n, "or"))
+        return LEVEL_OR;
+
+    for (int i = 0; spin_binary[i].op != NULL; i++) {
+        if (tok.isOperator(n, spin_binary[i].op))
+            return spin_binary[i].level;
+    }
+    return 0;
+}
+
+SpinExpression::Value SpinExpression::expression(int level)
+{
+    if (level == 0)
+        return unary();
+
+    if (level == LEVEL_NOT) {
+        if (tok.isName(n, "not")) {
+            n++;
+            Value v = expression(LEVEL_NOT);
+            if (!v.valid || v.real)
+                return invalid();
+            return integer(v.integer ? 0 : -1);
+        }
+        return expression(level-1);
+    }
+
+    Value left = expression(level-1);
+    while (binaryLevel(n) == level) {
+        int op = n++;
+        Value right = expression(level-1);
+        left = apply(op, left, right);
+    }
+    return left;
+}
+
+SpinExpression::Value SpinExpression::apply(int op, const Value & a, const Value & b) const
+{
+    if (!a.valid || !b.valid || a.real != b.real)
+        return invalid();
+
+    if (a.real) {
+        float x = a.number;
+        float y = b.number;
+        if (tok.isOperator(op, "+"))    return real(x + y);
+        if (tok.isOperator(op, "-"))    return real(x - y);
+        if (tok.isOperator(op, "*"))    return real(x * y);
+        if (tok.isOperator(op, "/"))    return y != 0 ? real(x / y) : invalid();
+        if (tok.isOperator(op, "#>"))   return real(x > y ? x : y);
+        if (tok.isOperator(op, "<#"))   return real(x < y ? x : y);
+        if (tok.isOperator(op, "<"))    return integer(x < y ? -1 : 0);
+        if (tok.isOperator(op, ">"))    return integer(x > y ? -1 : 0);
+        if (tok.isOperator(op, "<>"))   return integer(x != y ? -1 : 0);
+        if (tok.isOperator(op, "=="))   return integer(x == y ? -1 : 0);
+        if (tok.isOperator(op, "=<"))   return integer(x <= y ? -1 : 0);
+        if (tok.isOperator(op, "=>"))   return integer(x >= y ? -1 : 0);
+        return invalid();
+    }
+
+    // unsigned, so overflow wraps instead of being undefined
+    quint32 x = a.integer;
+    quint32 y = b.integer;
+    qint32 sx = a.integer;
+    qint32 sy = b.integer;
+    int bits = y & 31;
+
+    if (tok.isName(op, "and"))      return integer(sx && sy ? -1 : 0);
+    if (tok.isName(op, "or"))       return integer(sx || sy ? -1 : 0);
+    if (tok.isOperator(op, "->"))   return integer(bits ? (x >> bits) | (x << (32 - bits)) : x);
+    if (tok.isOperator(op, "<-"))   return integer(bits ? (x << bits) | (x >> (32 - bits)) : x);
+    if (tok.isOperator(op, ">>"))   return integer(x >> bits);
+    if (tok.isOperator(op, "<<"))   return integer(x << bits);
+    if (tok.isOperator(op, "~>"))   return integer(sx < 0 ? ~(~x >> bits) : x >> bits);
+    if (tok.isOperator(op, "><")) {
+        // reverse the lowest y bits, clear the rest
+        quint32 r = 0;
+        quint32 count = y < 32 ? y : 32;
+        for (quint32 i = 0; i < count; i++)
+            r |= ((x >> i) & 1) << (count - 1 - i);
+        return integer(r);
+    }
+    if (tok.isOperator(op, "&"))    return integer(x & y);
+    if (tok.isOperator(op, "|"))    return integer(x | y);
+    if (tok.isOperator(op, "^"))    return integer(x ^ y);
+    if (tok.isOperator(op, "*"))    return integer(x * y);
+    if (tok.isOperator(op, "**"))   return integer((qint64) sx * sy >> 32);
+    if (tok.isOperator(op, "/"))    return sy != 0 && !(sx == (qint32) 0x80000000 && sy == -1) ? integer(sx / sy) : invalid();
+    // x // -1 is 0, but INT_MIN % -1 overflows in C++
+    if (tok.isOperator(op, "//"))   return sy != 0 ? integer(sy != -1 ? sx % sy : 0) : invalid();
+    if (tok.isOperator(op, "+"))    return integer(x + y);
+    if (tok.isOperator(op, "-"))    return integer(x - y);
+    if (tok.isOperator(op, "#>"))   return integer(sx > sy ? sx : sy);
+    if (tok.isOperator(op, "<#"))   return integer(sx < sy ? sx : sy);
+    if (tok.isOperator(op, "<"))    return integer(sx < sy ? -1 : 0);
+    if (tok.isOperator(op, ">"))    return integer(sx > sy ? -1 : 0);
+    if (tok.isOperator(op, "<>"))   return integer(sx != sy ? -1 : 0);
+    if (tok.isOperator(op, "=="))   return integer(sx == sy ? -1 : 0);
+    if (tok.isOperator(op, "=<"))   return integer(sx <= sy ? -1 : 0);
+    if (tok.isOperator(op, "=>"))   return integer(sx >= sy ? -1 : 0);
+    return invalid();
+}
+
+SpinExpression::Value SpinExpression::unary()
+{
+    if (n >= tok.count())
+        return invalid();
+
+    if (tok.isOperator(n, "(")) {
+        n++;
+        Value v = expression(LEVEL_OR);
+        if (!tok.isOperator(n, ")"))
+            return invalid();
+        n++;
+        return v;
+    }
+
+    const SpinTokenizer::Token & t = tok.token(n);
+    if (t.type == SpinTokenizer::T_NUMBER)
+        return number();
+    if (t.type == SpinTokenizer::T_NAME)
+        return name();
+    if (t.type != SpinTokenizer::T_OPERATOR)
+        return invalid();
+
+    int op = n++;
+    Value v = unary();
+    if (!v.valid)
+        return v;
+
+    if (v.real) {
+        if (tok.isOperator(op, "-"))    return real(-v.number);
+        if (tok.isOperator(op, "+"))    return v;
+        if (tok.isOperator(op, "||"))   return real(fabsf(v.number));
+        if (tok.isOperator(op, "^^"))   return v.number >= 0 ? real(sqrtf(v.number)) : invalid();
+        return invalid();
+    }
+
+    quint32 x = v.integer;
+    if (tok.isOperator(op, "-"))        return integer(0 - x);
+    if (tok.isOperator(op, "+"))        return v;
+    if (tok.isOperator(op, "!"))        return integer(~x);
+    if (tok.isOperator(op, "||"))       return integer(v.integer < 0 ? 0 - x : x);
+    if (tok.isOperator(op, "^^"))       return integer((qint32) sqrt((double) x));
+    if (tok.isOperator(op, "|<"))       return integer((quint32) 1 << (x & 31));
+    if (tok.isOperator(op, ">|")) {
+        // the number of the highest bit set, counting from 1
+        int bit = 0;
+        while (x) {
+            bit++;
+            x >>= 1;
+        }
+        return integer(bit);
+    }
+    return invalid();
+}
+
+/* $hex, %bin, %%quaternary, decimal or float, all with _ groups */
+SpinExpression::Value SpinExpression::number()
+{
+    QString s = tok.text(n++).toString().remove('_');
+    bool ok = false;
+
+    if (s.startsWith("%%")) {
+        quint32 v = 0;
+        for (int i = 2; i < s.length(); i++) {
+            if (s.at(i) < '0' || s.at(i) > '3')
+                return invalid();
+            v = v * 4 + (s.at(i).unicode() - '0');
+        }
+        return s.length() > 2 ? integer(v) : invalid();
+    }
+    if (s.startsWith('$')) {
+        quint32 v = s.mid(1).toUInt(&ok, 16);
+        return ok ? integer(v) : invalid();
+    }
+    if (s.startsWith('%')) {
+        quint32 v = s.mid(1).toUInt(&ok, 2);
+        return ok ? integer(v) : invalid();
+    }
+    if (s.contains('.') || s.contains('e', Qt::CaseInsensitive)) {
+        float f = s.toFloat(&ok);
+        return ok ? real(f) : invalid();
+    }
+
+    quint32 v = s.toUInt(&ok, 10);
+    return ok ? integer(v) : invalid();
+}
+
+/* float(x), round(x), trunc(x) and constant(x) */
+SpinExpression::Value SpinExpression::function(int f)
+{
+    n++;
+    Value v = expression(LEVEL_OR);
+    if (!tok.isOperator(n, ")") || !v.valid)
+        return invalid();
+    n++;
+
+    if (tok.isName(f, "constant"))
+        return v;
+    if (tok.isName(f, "float"))
+        return v.real ? invalid() : real(v.integer);
+    if (!v.real)
+        return invalid();
+    if (tok.isName(f, "round"))
+        return integer((qint32) floorf(v.number + 0.5f));
+    return integer((qint32) v.number);
+}
+
+SpinExpression::Value SpinExpression::name()
+{
+    int f = n++;
+
+    if (tok.isOperator(n, "(")) {
+        if (tok.isName(f, "float") || tok.isName(f, "round")
+                || tok.isName(f, "trunc") || tok.isName(f, "constant"))
+            return function(f);
+        return invalid();
+    }
+
+    if (tok.isName(f, "pi"))
+        return real(3.14159265f);
+
+    for (int i = 0; spin_constants[i].name != NULL; i++) {
+        if (tok.isName(f, spin_constants[i].name))
+            return integer(spin_constants[i].value);
+    }
+
+    // obj#NAME is a constant of another object
+    if (tok.isOperator(n, "#") && n+1 < tok.count()
+            && tok.token(n+1).type == SpinTokenizer::T_NAME) {
+        n += 2;
+        return resolver.constant(tok.text(f).toString(), tok.text(n-1).toString());
+    }
+
+    return resolver.constant(QString(), tok.text(f).toString());
+}
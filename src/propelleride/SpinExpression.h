@@ -0,0 +1,61 @@
+#pragma once
+
+#include <QString>
+
+#include "SpinTokenizer.h"
+
+/*
+ * Works out the value of a Spin constant expression, such as the
+ * right hand side of a CON assignment.
+ *
+ * Operators have the precedence of the Spin manual. Integers are 32
+ * bits and wrap like they do on the Propeller. Float constants such as
+ * 1.5 or float(x) only mix with floats, the compiler rejects the rest,
+ * so such an expression has no value here either.
+ *
+ * The names an expression uses, other than the built in ones such as
+ * TRUE or PLL16X, are looked up through a Resolver.
+ */
+class SpinExpression
+{
+public:
+    typedef struct {
+        bool valid;
+        bool real;          /* a float, number holds it */
+        qint32 integer;
+        float number;
+    } Value;
+
+    class Resolver
+    {
+    public:
+        virtual ~Resolver() {}
+
+        /* the value of name, or of object#name if object isn't empty */
+        virtual Value constant(const QString & object, const QString & name) = 0;
+    };
+
+    static Value evaluate(const QString & expression, Resolver & resolver);
+
+    /* the value as Spin source would write it, empty if it isn't valid */
+    static QString toString(const Value & value);
+
+    static Value invalid();
+    static Value integer(qint32 i);
+    static Value real(float f);
+
+private:
+    SpinExpression(const SpinTokenizer & tok, Resolver & resolver);
+
+    Value expression(int level);
+    Value unary();
+    Value name();
+    Value number();
+    Value function(int n);
+    int  binaryLevel(int n) const;
+    Value apply(int op, const Value & a, const Value & b) const;
+
+    const SpinTokenizer & tok;
+    Resolver & resolver;
+    int n;
+};
@@ -0,0 +1,165 @@
+#include "SpinFileResolver.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QMetaObject>
+#include <QMutexLocker>
+#include <QThread>
+
+SpinFileResolver::SpinFileResolver(QObject * parent)
+    : QObject(parent)
+{
+    connect(&watcher, SIGNAL(directoryChanged(QString)),
+            this, SLOT(directoryChanged(QString)));
+}
+
+const SpinFileResolver::Listing & SpinFileResolver::listing(QString dir)
+{
+    dir = QDir::cleanPath(QDir(dir).absolutePath());
+
+    QHash<QString, Listing>::const_iterator i = listings.constFind(dir);
+    if (i != listings.constEnd())
+        return i.value();
+
+    Listing l;
+
+    // a missing directory can't be watched, the closest parent that exists is
+    if (!QFileInfo(dir).isDir()) {
+        static const Listing none;
+
+        QString parent = dir;
+        while (!QFileInfo(parent).isDir()) {
+            QString up = QFileInfo(parent).absolutePath();
+
+            // a drive or share that isn't there, nothing to watch and keep
+            if (up == parent)
+                return none;
+            parent = up;
+        }
+
+        watch(parent);
+        missing[parent].insert(dir);
+        return listings.insert(dir, l).value();
+    }
+
+    watch(dir);
+
+    l.entries = QDir(dir).entryList();
+    foreach (const QString & s, l.entries) {
+        l.files.insert(s);
+        QString lower = s.toLower();
+        if (!l.names.contains(lower))
+            l.names.insert(lower, s);
+    }
+
+    return listings.insert(dir, l).value();
+}
+
+void SpinFileResolver::watch(const QString & dir)
+{
+    if (watched.contains(dir))
+        return;
+    watched.insert(dir);
+
+    if (QThread::currentThread() == thread()) {
+        if (!watcher.directories().contains(dir))
+            watcher.addPath(dir);
+    }
+    else {
+        QMetaObject::invokeMethod(this, "addWatch", Qt::QueuedConnection, Q_ARG(QString, dir));
+    }
+}
+
+bool SpinFileResolver::listed(QString fileName)
+{
+    QFileInfo info(fileName);
+    return listing(info.absolutePath()).files.contains(info.fileName());
+}
+
+bool SpinFileResolver::exists(QString fileName)
+{
+    QMutexLocker locker(&mutex);
+    return listed(fileName);
+}
+
+QString SpinFileResolver::resolve(QString fileName, QString parentFile, QString libraryPath)
+{
+    QString shortfile = fileName.mid(fileName.lastIndexOf("/")+1);
+    QString path = parentFile.mid(0,parentFile.lastIndexOf("/")+1);
+    QString key = fileName + '\n' + path + '\n' + libraryPath;
+
+    QMutexLocker locker(&mutex);
+
+    QHash<QString, QString>::const_iterator i = resolved.constFind(key);
+    if (i != resolved.constEnd())
+        return i.value();
+
+    QString retfile = fileName;
+
+    if (listed(fileName)) {
+        retfile = fileName;
+    }
+    else if (listed(path+fileName)) {
+        retfile = path+fileName;
+    }
+    else if (listed(libraryPath+fileName)) {
+        retfile = libraryPath+fileName;
+    }
+    else {
+        QString s = listing(path).names.value(shortfile.toLower());
+        if (!s.isEmpty()) {
+            retfile = path+s;
+        }
+        else {
+            foreach (const QString & s, listing(libraryPath).entries) {
+                if (s.contains(shortfile,Qt::CaseInsensitive)) {
+                    retfile = libraryPath+"/"+s;
+                    break;
+                }
+            }
+        }
+    }
+
+    resolved.insert(key, retfile);
+    return retfile;
+}
+
+/*
+ * dir was read before the watch existed, read it again. only results
+ * that went through dir are dropped, a scan adds many watches.
+ */
+void SpinFileResolver::addWatch(QString dir)
+{
+    if (!watcher.directories().contains(dir))
+        watcher.addPath(dir);
+
+    QMutexLocker locker(&mutex);
+    forget(dir);
+
+    QHash<QString, QString>::iterator i = resolved.begin();
+    while (i != resolved.end()) {
+        if (i.key().contains(dir) || i.value().contains(dir))
+            i = resolved.erase(i);
+        else
+            ++i;
+    }
+}
+
+void SpinFileResolver::directoryChanged(const QString & dir)
+{
+    QMutexLocker locker(&mutex);
+    forget(dir);
+    resolved.clear();
+
+    // the watcher forgets a directory that is gone
+    if (!QFileInfo(dir).isDir())
+        watched.remove(dir);
+}
+
+/* drop the listing of dir and of the missing directories below it */
+void SpinFileResolver::forget(const QString & dir)
+{
+    listings.remove(dir);
+    foreach (const QString & s, missing.take(dir))
+        listings.remove(s);
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QSet>
+#include <QMutex>
+#include <QFileSystemWatcher>
+
+/*
+ * Finds the files OBJ sections refer to.
+ *
+ * Every directory searched is listed once and kept with a lower case
+ * name map, so looking a file up doesn't touch the disk again. Results
+ * are remembered too. A QFileSystemWatcher drops a listing, and all
+ * remembered results, as soon as its directory changes. A missing
+ * directory is kept as an empty listing until its parent changes.
+ *
+ * resolve() and exists() may be called from scan tasks, the watcher
+ * is only touched on the thread the resolver lives in. There the watch
+ * is added before the directory is read. A scan task can't add it, so
+ * what it reads is dropped once the watch is in place and read again.
+ */
+class SpinFileResolver : public QObject
+{
+    Q_OBJECT
+
+public:
+    SpinFileResolver(QObject * parent = 0);
+
+    /*
+     * find fileName next to parentFile or in the library path.
+     * fileName is returned as it is if it can't be found.
+     */
+    QString resolve(QString fileName, QString parentFile, QString libraryPath);
+
+    /* true if fileName is listed in its directory */
+    bool exists(QString fileName);
+
+private slots:
+    void addWatch(QString dir);
+    void directoryChanged(const QString & dir);
+
+private:
+    typedef struct {
+        QStringList entries;            /* as returned by QDir::entryList */
+        QSet<QString> files;
+        QHash<QString, QString> names;  /* lower case name to entry */
+    } Listing;
+
+    /* these expect mutex to be held */
+    const Listing & listing(QString dir);
+    bool listed(QString fileName);
+    void watch(const QString & dir);
+    void forget(const QString & dir);
+
+    QMutex mutex;
+    QHash<QString, Listing> listings;
+    QHash<QString, QString> resolved;
+    QHash<QString, QSet<QString> > missing;     /* watched directory to missing ones below it */
+    QSet<QString> watched;
+
+    QFileSystemWatcher watcher;
+};
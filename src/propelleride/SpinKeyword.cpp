@@ -0,0 +1,187 @@
+#include "SpinKeyword.h"
+
+#include <string.h>
+
+/*
+ * The table is built like this: a word's 32 bit FNV-1a hash picks one
+ * of BUCKETS buckets, and the bucket's displacement d moves its words
+ * to the slot ((hash ^ d) * 0x9e3779b9) >> (32 - TABLE_BITS). The
+ * displacements were searched, largest bucket first, so no two words
+ * share a slot. They have to be searched again when a word is added.
+ */
+#define TABLE_BITS  8
+#define TABLE_SIZE  (1 << TABLE_BITS)
+#define BUCKETS     64
+#define MIN_LENGTH  2
+#define MAX_LENGTH  12
+
+typedef struct {
+    const char * word;
+    SpinKeyword::Id id;
+} Entry;
+
+static const quint8 displacements[BUCKETS] = {
+    1, 3, 1, 3, 6, 1, 0, 0, 27, 1, 14, 8, 1, 6, 45, 6,
+    5, 2, 18, 1, 2, 20, 4, 2, 2, 56, 0, 0, 0, 43, 2, 114,
+    6, 4, 10, 20, 0, 2, 0, 26, 8, 11, 22, 33, 3, 26, 0, 8,
+    30, 3, 45, 30, 1, 22, 21, 2, 18, 52, 2, 13, 5, 34, 0, 13
+};
+
+static const Entry table[TABLE_SIZE] = {
+    { "repeat", SpinKeyword::KW_RESERVED }, { NULL, SpinKeyword::KW_NONE },
+    { NULL, SpinKeyword::KW_NONE }, { "if_z_eq_c", SpinKeyword::KW_RESERVED },
+    { "next", SpinKeyword::KW_RESERVED }, { "elseif", SpinKeyword::KW_RESERVED },
+    { "addabs", SpinKeyword::KW_RESERVED }, { "_xinfreq", SpinKeyword::KW_RESERVED },
+    { "xtal3", SpinKeyword::KW_RESERVED }, { NULL, SpinKeyword::KW_NONE },
+    { "sub", SpinKeyword::KW_RESERVED }, { "cogid", SpinKeyword::KW_RESERVED },
+    { NULL, SpinKeyword::KW_NONE }, { "if_c_or_nz", SpinKeyword::KW_RESERVED },
+    { NULL, SpinKeyword::KW_NONE }, { NULL, SpinKeyword::KW_NONE },
+    { "pri", SpinKeyword::KW_PRI }, { "fit", SpinKeyword::KW_RESERVED },
+    { "from", SpinKeyword::KW_RESERVED }, { NULL, SpinKeyword::KW_NONE },
+    { "wz", SpinKeyword::KW_RESERVED }, { "xtal2", SpinKeyword::KW_RESERVED },
+    { "ror", SpinKeyword::KW_RESERVED }, { "constant", SpinKeyword::KW_RESERVED },
+    { "ctra", SpinKeyword::KW_RESERVED }, { "ifnot", SpinKeyword::KW_RESERVED },
+    { "if_a", SpinKeyword::KW_RESERVED }, { "if_nc_or_nz", SpinKeyword::KW_RESERVED },
+    { "longfill", SpinKeyword::KW_RESERVED }, { "lookupz", SpinKeyword::KW_RESERVED },
+    { "wrbyte", SpinKeyword::KW_RESERVED }, { "lookup", SpinKeyword::KW_RESERVED },
+    { "absneg", SpinKeyword::KW_RESERVED }, { "locknew", SpinKeyword::KW_RESERVED },
+    { NULL, SpinKeyword::KW_NONE }, { "movs", SpinKeyword::KW_RESERVED },
+    { "if_nc_or_z", SpinKeyword::KW_RESERVED }, { "cmpx", SpinKeyword::KW_RESERVED },
+    { "cmpsx", SpinKeyword::KW_RESERVED }, { "abort", SpinKeyword::KW_RESERVED },
+    { NULL, SpinKeyword::KW_NONE }, { "or", SpinKeyword::KW_RESERVED },
+    { "if_z_or_c", SpinKeyword::KW_RESERVED }, { NULL, SpinKeyword::KW_NONE },
+    { "not", SpinKeyword::KW_RESERVED }, { "con", SpinKeyword::KW_CON },
+    { "ret", SpinKeyword::KW_RESERVED }, { "word", SpinKeyword::KW_WORD },
+    { "negc", SpinKeyword::KW_RESERVED }, { "pi", SpinKeyword::KW_RESERVED },
+    { "result", SpinKeyword::KW_RESERVED }, { NULL, SpinKeyword::KW_NONE },
+    { "return", SpinKeyword::KW_RESERVED }, { "else", SpinKeyword::KW_RESERVED },
+    { "if_z_and_nc", SpinKeyword::KW_RESERVED }, { "wrword", SpinKeyword::KW_RESERVED },
+    { NULL, SpinKeyword::KW_NONE }, { "negnz", SpinKeyword::KW_RESERVED },
+    { "andn", SpinKeyword::KW_RESERVED }, { "string", SpinKeyword::KW_RESERVED },
+    { NULL, SpinKeyword::KW_NONE }, { "wrlong", SpinKeyword::KW_RESERVED },
+    { "if_b", SpinKeyword::KW_RESERVED }, { "subs", SpinKeyword::KW_RESERVED },
+    { "subsx", SpinKeyword::KW_RESERVED }, { "maxs", SpinKeyword::KW_RESERVED },
+    { "rdbyte", SpinKeyword::KW_RESERVED }, { "addx", SpinKeyword::KW_RESERVED },
+    { "pub", SpinKeyword::KW_PUB }, { "tjnz", SpinKeyword::KW_RESERVED },
+    { "vscl", SpinKeyword::KW_RESERVED }, { "negx", SpinKeyword::KW_RESERVED },
+    { "reboot", SpinKeyword::KW_RESERVED }, { "if_e", SpinKeyword::KW_RESERVED },
+    { "mul", SpinKeyword::KW_RESERVED }, { "djnz", SpinKeyword::KW_RESERVED },
+    { "obj", SpinKeyword::KW_OBJ }, { "_stack", SpinKeyword::KW_RESERVED },
+    { "cognew", SpinKeyword::KW_RESERVED }, { "jmp", SpinKeyword::KW_RESERVED },
+    { "hubop", SpinKeyword::KW_RESERVED }, { "phsa", SpinKeyword::KW_RESERVED },
+    { NULL, SpinKeyword::KW_NONE }, { "longmove", SpinKeyword::KW_RESERVED },
+    { "outa", SpinKeyword::KW_RESERVED }, { "if_c_and_nz", SpinKeyword::KW_RESERVED },
+    { "step", SpinKeyword::KW_RESERVED }, { "testn", SpinKeyword::KW_RESERVED },
+    { "if_c_and_z", SpinKeyword::KW_RESERVED }, { "bytemove", SpinKeyword::KW_RESERVED },
+    { "to", SpinKeyword::KW_RESERVED }, { "pll16x", SpinKeyword::KW_RESERVED },
+    { "if_c_eq_z", SpinKeyword::KW_RESERVED }, { "if", SpinKeyword::KW_RESERVED },
+    { "if_nc_and_z", SpinKeyword::KW_RESERVED }, { "lookdownz", SpinKeyword::KW_RESERVED },
+    { "wr", SpinKeyword::KW_RESERVED }, { "if_nz_and_c", SpinKeyword::KW_RESERVED },
+    { "quit", SpinKeyword::KW_RESERVED }, { NULL, SpinKeyword::KW_NONE },
+    { "abs", SpinKeyword::KW_RESERVED }, { NULL, SpinKeyword::KW_NONE },
+    { NULL, SpinKeyword::KW_NONE }, { "if_z_ne_c", SpinKeyword::KW_RESERVED },
+    { "trunc", SpinKeyword::KW_RESERVED }, { "long", SpinKeyword::KW_LONG },
+    { NULL, SpinKeyword::KW_NONE }, { "negz", SpinKeyword::KW_RESERVED },
+    { "rcr", SpinKeyword::KW_RESERVED }, { NULL, SpinKeyword::KW_NONE },
+    { "_clkfreq", SpinKeyword::KW_RESERVED }, { NULL, SpinKeyword::KW_NONE },
+    { "frqb", SpinKeyword::KW_RESERVED }, { "if_never", SpinKeyword::KW_RESERVED },
+    { "_clkmode", SpinKeyword::KW_RESERVED }, { "if_c_or_z", SpinKeyword::KW_RESERVED },
+    { NULL, SpinKeyword::KW_NONE }, { NULL, SpinKeyword::KW_NONE },
+    { "if_c_ne_z", SpinKeyword::KW_RESERVED }, { "if_ae", SpinKeyword::KW_RESERVED },
+    { "dira", SpinKeyword::KW_RESERVED }, { NULL, SpinKeyword::KW_NONE },
+    { "res", SpinKeyword::KW_RESERVED }, { "org", SpinKeyword::KW_RESERVED },
+    { "wc", SpinKeyword::KW_RESERVED }, { NULL, SpinKeyword::KW_NONE },
+    { "bytefill", SpinKeyword::KW_RESERVED }, { NULL, SpinKeyword::KW_NONE },
+    { "while", SpinKeyword::KW_RESERVED }, { "ctrb", SpinKeyword::KW_RESERVED },
+    { "if_z_and_c", SpinKeyword::KW_RESERVED }, { "sar", SpinKeyword::KW_RESERVED },
+    { "vcfg", SpinKeyword::KW_RESERVED }, { "file", SpinKeyword::KW_RESERVED },
+    { "nr", SpinKeyword::KW_RESERVED }, { NULL, SpinKeyword::KW_NONE },
+    { "wordmove", SpinKeyword::KW_RESERVED }, { NULL, SpinKeyword::KW_NONE },
+    { "outb", SpinKeyword::KW_RESERVED }, { NULL, SpinKeyword::KW_NONE },
+    { "pll1x", SpinKeyword::KW_RESERVED }, { "if_nc", SpinKeyword::KW_RESERVED },
+    { "clkmode", SpinKeyword::KW_RESERVED }, { "rcfast", SpinKeyword::KW_RESERVED },
+    { NULL, SpinKeyword::KW_NONE }, { "dat", SpinKeyword::KW_DAT },
+    { "lockclr", SpinKeyword::KW_RESERVED }, { NULL, SpinKeyword::KW_NONE },
+    { "false", SpinKeyword::KW_RESERVED }, { NULL, SpinKeyword::KW_NONE },
+    { "subabs", SpinKeyword::KW_RESERVED }, { "rcslow", SpinKeyword::KW_RESERVED },
+    { "waitcnt", SpinKeyword::KW_RESERVED }, { "if_c", SpinKeyword::KW_RESERVED },
+    { NULL, SpinKeyword::KW_NONE }, { "muls", SpinKeyword::KW_RESERVED },
+    { NULL, SpinKeyword::KW_NONE }, { "waitpne", SpinKeyword::KW_RESERVED },
+    { "test", SpinKeyword::KW_RESERVED }, { NULL, SpinKeyword::KW_NONE },
+    { "xor", SpinKeyword::KW_RESERVED }, { "if_nc_and_nz", SpinKeyword::KW_RESERVED },
+    { "coginit", SpinKeyword::KW_RESERVED }, { "ina", SpinKeyword::KW_RESERVED },
+    { "enc", SpinKeyword::KW_RESERVED }, { "movi", SpinKeyword::KW_RESERVED },
+    { "waitpeq", SpinKeyword::KW_RESERVED }, { "rdlong", SpinKeyword::KW_RESERVED },
+    { "if_z", SpinKeyword::KW_RESERVED }, { "waitvid", SpinKeyword::KW_RESERVED },
+    { "subx", SpinKeyword::KW_RESERVED }, { "round", SpinKeyword::KW_RESERVED },
+    { "call", SpinKeyword::KW_RESERVED }, { "lookdown", SpinKeyword::KW_RESERVED },
+    { "if_nz_and_nc", SpinKeyword::KW_RESERVED }, { "mov", SpinKeyword::KW_RESERVED },
+    { "cmp", SpinKeyword::KW_RESERVED }, { "adds", SpinKeyword::KW_RESERVED },
+    { "chipver", SpinKeyword::KW_RESERVED }, { "shr", SpinKeyword::KW_RESERVED },
+    { "inb", SpinKeyword::KW_RESERVED }, { "muxnz", SpinKeyword::KW_RESERVED },
+    { "phsb", SpinKeyword::KW_RESERVED }, { NULL, SpinKeyword::KW_NONE },
+    { "nop", SpinKeyword::KW_RESERVED }, { "addsx", SpinKeyword::KW_RESERVED },
+    { "true", SpinKeyword::KW_RESERVED }, { "min", SpinKeyword::KW_RESERVED },
+    { "cmpsub", SpinKeyword::KW_RESERVED }, { "if_nz_or_c", SpinKeyword::KW_RESERVED },
+    { "until", SpinKeyword::KW_RESERVED }, { "case", SpinKeyword::KW_RESERVED },
+    { "movd", SpinKeyword::KW_RESERVED }, { NULL, SpinKeyword::KW_NONE },
+    { "pll8x", SpinKeyword::KW_RESERVED }, { "xtal1", SpinKeyword::KW_RESERVED },
+    { "ones", SpinKeyword::KW_RESERVED }, { "posx", SpinKeyword::KW_RESERVED },
+    { "clkfreq", SpinKeyword::KW_RESERVED }, { NULL, SpinKeyword::KW_NONE },
+    { "rev", SpinKeyword::KW_RESERVED }, { "negnc", SpinKeyword::KW_RESERVED },
+    { "muxc", SpinKeyword::KW_RESERVED }, { "jmpret", SpinKeyword::KW_RESERVED },
+    { "par", SpinKeyword::KW_RESERVED }, { "var", SpinKeyword::KW_VAR },
+    { "_free", SpinKeyword::KW_RESERVED }, { NULL, SpinKeyword::KW_NONE },
+    { "other", SpinKeyword::KW_RESERVED }, { "sumz", SpinKeyword::KW_RESERVED },
+    { "dirb", SpinKeyword::KW_RESERVED }, { "mins", SpinKeyword::KW_RESERVED },
+    { "xinput", SpinKeyword::KW_RESERVED }, { "cmps", SpinKeyword::KW_RESERVED },
+    { "if_z_or_nc", SpinKeyword::KW_RESERVED }, { "pll4x", SpinKeyword::KW_RESERVED },
+    { "muxz", SpinKeyword::KW_RESERVED }, { "lockset", SpinKeyword::KW_RESERVED },
+    { NULL, SpinKeyword::KW_NONE }, { "byte", SpinKeyword::KW_BYTE },
+    { "cnt", SpinKeyword::KW_RESERVED }, { "if_be", SpinKeyword::KW_RESERVED },
+    { NULL, SpinKeyword::KW_NONE }, { "if_nz_or_nc", SpinKeyword::KW_RESERVED },
+    { "rcl", SpinKeyword::KW_RESERVED }, { "strsize", SpinKeyword::KW_RESERVED },
+    { "elseifnot", SpinKeyword::KW_RESERVED }, { "float", SpinKeyword::KW_RESERVED },
+    { NULL, SpinKeyword::KW_NONE }, { "tjz", SpinKeyword::KW_RESERVED },
+    { NULL, SpinKeyword::KW_NONE }, { "wordfill", SpinKeyword::KW_RESERVED },
+    { "lockret", SpinKeyword::KW_RESERVED }, { NULL, SpinKeyword::KW_NONE },
+    { "spr", SpinKeyword::KW_RESERVED }, { "rol", SpinKeyword::KW_RESERVED },
+    { "pll2x", SpinKeyword::KW_RESERVED }, { "clkset", SpinKeyword::KW_RESERVED },
+    { "neg", SpinKeyword::KW_RESERVED }, { "shl", SpinKeyword::KW_RESERVED },
+    { NULL, SpinKeyword::KW_NONE }, { "frqa", SpinKeyword::KW_RESERVED },
+    { "if_always", SpinKeyword::KW_RESERVED }, { "add", SpinKeyword::KW_RESERVED },
+    { "if_nz", SpinKeyword::KW_RESERVED }, { NULL, SpinKeyword::KW_NONE },
+    { "strcomp", SpinKeyword::KW_RESERVED }, { "and", SpinKeyword::KW_RESERVED },
+    { "if_ne", SpinKeyword::KW_RESERVED }, { "sumnz", SpinKeyword::KW_RESERVED },
+    { "muxnc", SpinKeyword::KW_RESERVED }, { "cogstop", SpinKeyword::KW_RESERVED },
+    { "max", SpinKeyword::KW_RESERVED }, { "rdword", SpinKeyword::KW_RESERVED },
+    { "sumc", SpinKeyword::KW_RESERVED }, { "sumnc", SpinKeyword::KW_RESERVED }
+};
+
+SpinKeyword::Id SpinKeyword::find(const QChar * word, int length)
+{
+    if (length < MIN_LENGTH || length > MAX_LENGTH)
+        return KW_NONE;
+
+    char lower[MAX_LENGTH];
+    quint32 hash = 2166136261u;
+
+    for (int i = 0; i < length; i++) {
+        ushort c = word[i].unicode();
+        if (c >= 'A' && c <= 'Z')
+            c += 'a' - 'A';
+        else if (c > 127)
+            return KW_NONE;
+
+        lower[i] = (char) c;
+        hash = (hash ^ c) * 16777619u;
+    }
+
+    quint32 slot = ((hash ^ displacements[hash & (BUCKETS-1)]) * 0x9e3779b9u) >> (32 - TABLE_BITS);
+
+    const Entry & e = table[slot];
+    if (e.word == NULL || strncmp(e.word, lower, length) != 0 || e.word[length] != '\0')
+        return KW_NONE;
+
+    return e.id;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <QChar>
+#include <QString>
+#include <QStringRef>
+
+/*
+ * Classifies a word as one of the Spin and PASM reserved words.
+ *
+ * The words are those of the modes in languages/spin.json, where NOT
+ * is an operator. They are kept in a perfect hash table, so a lookup
+ * hashes the word once, reads one slot and compares one string,
+ * whatever the word is.
+ * Words are case insensitive.
+ */
+class SpinKeyword
+{
+public:
+    typedef enum {
+        KW_NONE,        /* not a reserved word */
+        KW_CON,
+        KW_VAR,
+        KW_OBJ,
+        KW_PUB,
+        KW_PRI,
+        KW_DAT,
+        KW_BYTE,
+        KW_WORD,
+        KW_LONG,
+        KW_RESERVED     /* any other reserved word */
+    } Id;
+
+    static Id find(const QChar * word, int length);
+    static Id find(const QStringRef & word)   { return find(word.unicode(), word.length()); }
+    static Id find(const QString & word)      { return find(word.unicode(), word.length()); }
+
+    /* BYTE, WORD and LONG */
+    static bool isSize(Id id)       { return id >= KW_BYTE && id <= KW_LONG; }
+};
@@ -1,43 +1,155 @@
 #include "SpinParser.h"
 
-#define KEY_ELEMENT_SEP ':'
+#include <algorithm>
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QFileInfo>
+#include <QMetaObject>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QSaveFile>
+#include <QSet>
+#include <QSettings>
+#include <QStandardPaths>
+#include <QWaitCondition>
+
+/*
+ * library index file layout, bump the version
+ * whenever FileRecord or what the parser records changes.
+ */
+#define INDEX_MAGIC     0x53504958  // "SPIX"
+#define INDEX_VERSION   5
+
+/*
+ * shared state of one project scan.
+ * tasks only touch files, scheduled and the result while holding mutex.
+ * pending counts the tasks that have been started but not finished,
+ * the task that brings it to zero links the project.
+ */
+class SpinParser::Scan
+{
+public:
+    Scan() : done(false) {}
+
+    QString file;
+    QString top;
+    QString libraryPath;
+
+    QAtomicInt cancelled;
+    QAtomicInt pending;
+
+    QMutex mutex;
+    QWaitCondition finished;
+    bool done;
+
+    QSet<QString> scheduled;
+    QHash<QString, ScannedFile> files;
+    QSharedPointer<const Snapshot> result;
+};
+
+/* parses one file of a scan on the thread pool */
+class SpinParser::ScanTask : public QRunnable
+{
+public:
+    ScanTask(SpinParser * parser, QSharedPointer<Scan> scan, QString fileName)
+        : parser(parser), scan(scan), fileName(fileName)
+    {
+    }
+
+    void run()
+    {
+        if (!scan->cancelled.load())
+            parser->scanFile(scan, fileName);
+
+        if (!scan->pending.deref())
+            parser->finishScan(scan);
+    }
+
+private:
+    SpinParser * parser;
+    QSharedPointer<Scan> scan;
+    QString fileName;
+};
 
 SpinParser::SpinParser()
 {
+    indexWritable = true;
+
     setKind(&SpinKinds[SpinParser::K_NONE],     false,'n', "none", "none"); // place-holder only
     setKind(&SpinKinds[SpinParser::K_CONST],    true, 'c', "constant", "constants");
     setKind(&SpinKinds[SpinParser::K_PUB],      true, 'f', "public", "methods");
     setKind(&SpinKinds[SpinParser::K_PRI],      true, 'p', "private", "functions");
     setKind(&SpinKinds[SpinParser::K_OBJECT],   true, 'o', "obj", "objects");
+    setKind(&SpinKinds[SpinParser::K_TYPE],     false,'t', "type", "types"); // place-holder only
     setKind(&SpinKinds[SpinParser::K_VAR],      true, 'v', "var", "variables");
     setKind(&SpinKinds[SpinParser::K_DAT],      true, 'x', "dat", "dat");
+    setKind(&SpinKinds[SpinParser::K_ENUM],     true, 'e', "enum", "enumerations");
+    setKind(&SpinKinds[SpinParser::K_PARAM],    true, 'a', "param", "method parameters");
+    setKind(&SpinKinds[SpinParser::K_LOCAL],    true, 'l', "local", "method locals");
+    setKind(&SpinKinds[SpinParser::K_RESULT],   true, 'r', "result", "method results");
 
-    KeyWord keyCon = {"con", K_CONST, 0};
-    KeyWord keyObj = {"obj", K_OBJECT, 0};
-    KeyWord keyPub = {"pub", K_PUB, 0};
-    KeyWord keyPri = {"pri", K_PRI, 0};
-    KeyWord keyVar = {"var", K_VAR, 0};
-    KeyWord keyDat = {"dat", K_DAT, 0};
-    KeyWord keyNull= {NULL,  K_NONE, 0};
+    for (int n = 0; n < K_KINDS; n++)
+        kindLetters.append(SpinKinds[n].letter);
 
-    spin_keywords.append(keyCon);
-    spin_keywords.append(keyObj); // keep as item 1.
-    spin_keywords.append(keyPub);
-    spin_keywords.append(keyPri);
-    spin_keywords.append(keyVar);
-    spin_keywords.append(keyDat);
-    spin_keywords.append(keyNull);
+    clearDB();
+    loadIndex(QSettings().value("Library").toString());
 }
 
 SpinParser::~SpinParser()
 {
-    clearDB();
+    // running tasks call back into the parser, let them finish first
+    if (currentScan)
+        currentScan->cancelled.store(1);
+    pool.waitForDone();
+}
+
+void SpinParser::setIndexWritable(bool writable)
+{
+    indexWritable = writable;
 }
 
 void SpinParser::clearDB()
 {
-    db.clear();
-    spinFiles.clear();
+    project = QSharedPointer<const Snapshot>(new Snapshot);
+    constants.clear();
+}
+
+void SpinParser::setProject(QSharedPointer<const Snapshot> snapshot)
+{
+    QSharedPointer<const Snapshot> old = project;
+    project = snapshot;
+
+    if (constants.isEmpty() || !old)
+        return;
+
+    if (old->libraryPath != snapshot->libraryPath) {
+        constants.clear();
+        return;
+    }
+
+    // files that are gone, were parsed again or find other objects
+    QSet<QString> changed;
+    for (QHash<QString, ScannedFile>::const_iterator i = old->files.constBegin(); i != old->files.constEnd(); ++i) {
+        QHash<QString, ScannedFile>::const_iterator j = snapshot->files.constFind(i.key());
+        if (j == snapshot->files.constEnd()
+                || j.value().record.hash != i.value().record.hash
+                || j.value().objects != i.value().objects)
+            changed.insert(i.key());
+    }
+    if (changed.isEmpty())
+        return;
+
+    QMutableHashIterator<QString, ConstantValue> i(constants);
+    while (i.hasNext()) {
+        i.next();
+        foreach (const QString & file, i.value().files) {
+            if (changed.contains(file)) {
+                i.remove();
+                break;
+            }
+        }
+    }
 }
 
 void SpinParser::setKind(kindOption *kind, bool en, const char letter, const char *name, const char *desc)
@@ -55,502 +167,982 @@ void SpinParser::setKind(kindOption *kind, bool en, const char letter, const cha
  */
 QStringList SpinParser::spinFileTree(QString file, QString libpath)
 {
-    QString key;
-    QString value;
-    QString subnode;
-    QString subfile;
+    // this doesn't cancel a background scan, it only waits for its own
+    QSharedPointer<Scan> scan = startScan(file, libpath);
 
-    libraryPath = libpath;
-    clearDB();
+    scan->mutex.lock();
+    while (!scan->done)
+        scan->finished.wait(&scan->mutex);
+    setProject(scan->result);
+    scan->mutex.unlock();
+
+    reportDiagnostics();
+    return project->spinFiles;
+}
+
+void SpinParser::scanFileTree(QString file, QString libpath)
+{
+    if (currentScan)
+        currentScan->cancelled.store(1);
+
+    currentScan = startScan(file, libpath);
+}
+
+QStringList SpinParser::spinFileList()
+{
+    return project->spinFiles;
+}
+
+QList<SpinParser::ObjectNode> SpinParser::spinObjectTree()
+{
+    const SpinSymbolTable & symbols = project->symbols;
+    QList<ObjectNode> nodes;
+
+    foreach (int node, symbols.nodeList()) {
+        ObjectNode n = { symbols.string(node), symbols.string(symbols.nodeFile(node)) };
+        nodes.append(n);
+    }
+    return nodes;
+}
+
+QSharedPointer<SpinParser::Scan> SpinParser::startScan(QString file, QString libpath)
+{
+    QSharedPointer<Scan> scan(new Scan);
+    scan->file = file;
+    scan->libraryPath = libpath;
+    scan->top = resolver.resolve(file, file, libpath);
+
+    scan->scheduled.insert(scan->top);
+    startTask(scan, scan->top);
+    return scan;
+}
+
+void SpinParser::startTask(QSharedPointer<Scan> scan, QString fileName)
+{
+    scan->pending.ref();
+    pool.start(new ScanTask(this, scan, fileName));
+}
+
+/*
+ * runs on the thread pool.
+ * parse a file and start a task for every object file
+ * that no other task of the scan has picked up yet.
+ */
+void SpinParser::scanFile(QSharedPointer<Scan> scan, QString fileName)
+{
+    ScannedFile scanned;
+    bool parsed = false;
+    if(!loadFile(fileName, scanned.record, &parsed))
+        return;
+
+    if(parsed && !scan->libraryPath.isEmpty() && fileName.startsWith(scan->libraryPath))
+        indexDirty.store(1);
+
+    resolveObjects(scanned, fileName, scan->libraryPath);
+
+    QMutexLocker locker(&scan->mutex);
+    scan->files.insert(fileName, scanned);
+
+    foreach (QString file, scanned.objects) {
+        if(file.isEmpty() || scan->scheduled.contains(file))
+            continue;
+        if(scan->cancelled.load())
+            break;
+        scan->scheduled.insert(file);
+        startTask(scan, file);
+    }
+}
+
+/*
+ * runs on the thread pool once every file of a scan is parsed.
+ * link the files into a new snapshot and hand it to the gui thread.
+ */
+void SpinParser::finishScan(QSharedPointer<Scan> scan)
+{
+    Snapshot * snapshot = new Snapshot;
+    snapshot->file = scan->file;
+    snapshot->top = scan->top;
+    snapshot->libraryPath = scan->libraryPath;
+
+    if (!scan->cancelled.load()) {
+        snapshot->files = scan->files;
+        linkProject(*snapshot);
+    }
+
+    scan->mutex.lock();
+    scan->result = QSharedPointer<const Snapshot>(snapshot);
+    scan->done = true;
+    scan->files.clear();
+    scan->finished.wakeAll();
+    scan->mutex.unlock();
+
+    if (indexDirty.fetchAndStoreOrdered(0) && indexWritable)
+        saveIndex(scan->libraryPath);
+
+    QMetaObject::invokeMethod(this, "publishScan", Qt::QueuedConnection);
+}
+
+/* find the file behind every object a scanned file declares */
+void SpinParser::resolveObjects(ScannedFile & scanned, QString fileName, QString libpath)
+{
+    foreach (const FileSymbol & sym, scanned.record.symbols) {
+        if(sym.kind != K_OBJECT)
+            continue;
+
+        QString file = resolver.resolve(objectFile(sym.declaration), fileName, libpath);
+
+        // file is missing, ignore object
+        if(!resolver.exists(file))
+            file.clear();
+
+        scanned.objects.append(file);
+    }
+}
+
+/* build the symbols and file list of a snapshot from its scanned files */
+void SpinParser::linkProject(Snapshot & snapshot)
+{
+    QStringList ancestors;
+    QSet<QString> ancestorSet;
+    linkSpinTags(snapshot, snapshot.files, snapshot.top, "root", ancestors, ancestorSet);
 
-    this->findSpinTags(file, "root");
+    const SpinSymbolTable & symbols = snapshot.symbols;
 
-    spinFiles.append(file.mid(file.lastIndexOf("/")+1));
-    QStringList keys = db.keys();
+    snapshot.spinFiles.append(snapshot.file.mid(snapshot.file.lastIndexOf("/")+1));
 
     QStringList nodes;
-    foreach(key, keys) {
-        value = db[key];
-        QStringList tags = value.split("\t");
-		if (tags.count() < 4 || !tags[3].startsWith(SpinKinds[K_OBJECT].letter))
-            continue;	// short list or not an object
-        objectInfo(value, subnode, subfile);
-        nodes.append(subfile);
+    for (int sym = 0; sym < symbols.count(); sym++) {
+        if (symbols.kind(sym) != K_OBJECT)
+            continue;
+        nodes.append(objectFile(symbols.string(symbols.declaration(sym))));
     }
     nodes.sort(Qt::CaseInsensitive);
 
     for(int n = 0; n < nodes.count(); n++) {
         QString ns = nodes.at(n);
-        spinFiles.append(ns.mid(ns.lastIndexOf(":")+1));
+        snapshot.spinFiles.append(ns.mid(ns.lastIndexOf(":")+1));
     }
-    spinFiles.removeDuplicates();
-    return spinFiles;
+    snapshot.spinFiles.removeDuplicates();
 }
 
-QString SpinParser::tagItem(QStringList tabs, int field)
+void SpinParser::setOverlay(QString fileName, QString text, int firstLine, int lastLines)
 {
-    QString s;
-    if(tabs.length() > 2)
-        s = tabs.at(3)+"\t"+tabs.at(field);
-    return s;
+    QByteArray hash = QCryptographicHash::hash(text.toUtf8(), QCryptographicHash::Sha1);
+
+    // the text the changed lines are counted from
+    FileRecord base;
+    bool found = false;
+
+    cacheMutex.lock();
+    if (overlays.contains(fileName)) {
+        base = overlays.value(fileName);
+        found = true;
+    }
+    else if (fileCache.contains(fileName)) {
+        base = fileCache.value(fileName);
+        found = true;
+    }
+    bool same = overlays.contains(fileName) && base.hash == hash;
+    cacheMutex.unlock();
+
+    // such as after an undo back to the last overlay
+    if (same)
+        return;
+
+    FileRecord record;
+    if (!found || (firstLine == 0 && lastLines == 0)
+            || !reparseText(record, base, text, firstLine, lastLines)) {
+        record = FileRecord();
+        parseText(record, text);
+    }
+    record.hash = hash;
+
+    cacheMutex.lock();
+    overlays.insert(fileName, record);
+    cacheMutex.unlock();
+
+    updateProject(fileName, record);
+}
+
+void SpinParser::clearOverlay(QString fileName)
+{
+    cacheMutex.lock();
+    bool removed = overlays.remove(fileName) > 0;
+    cacheMutex.unlock();
+
+    if (!removed)
+        return;
+
+    FileRecord record;
+    if (loadFile(fileName, record))
+        updateProject(fileName, record);
 }
 
 /*
- * all symbols are accessible by key.
- * a key is a name list such as "/root/obj/subobj/subsubobj"
- * if the key is empty, return the root or top file list
+ * replace the symbols of one file in the current project, linking the
+ * files the project was built from again instead of reading them.
+ * if the file now uses an object the project doesn't have yet, or a
+ * scan may have read the file before it changed, scan the project again,
+ * which only reads what isn't cached.
  */
-QStringList SpinParser::spinSymbols(QString file, QString objname)
+void SpinParser::updateProject(QString fileName, const FileRecord & record)
 {
-    QStringList list;
-    QStringList keys = db.keys();
-    QString key;
-    QString value;
-    for(int n = 0; n < keys.length(); n++) {
-        key = keys[n];
-        value = db[key];
-        if(objname.length() > 0) {
-            if(key.contains(objname+":",Qt::CaseInsensitive)) {
-                QStringList tabs = value.split("\t");
-                if(tabs.count() > 2)
-                    list.append(tagItem(tabs,2));
-            }
-        }
-        else if(value.contains(file,Qt::CaseInsensitive)) {
-            QStringList tabs = value.split("\t");
-            if(tabs.count() > 2)
-                list.append(tagItem(tabs,2));
-        }
+    QSharedPointer<const Snapshot> current = project;
+
+    if (currentScan) {
+        scanFileTree(currentScan->file, currentScan->libraryPath);
+        return;
     }
-    QStringList plist;
-    QString     order("ofpcevx");
 
-    // sort the list by the order we want to have
-    // list.sort(); // could presort make it easier?
-    for(int j = 0; j < order.length(); j++) {
-        for(int n = 0; n < list.length(); n++) {
-            if(list.at(n).at(0) == order[j]) {
-                plist.append(list.at(n));
-            }
+    if (!current->files.contains(fileName))
+        return;
+
+    ScannedFile scanned;
+    scanned.record = record;
+    resolveObjects(scanned, fileName, current->libraryPath);
+
+    foreach (QString file, scanned.objects) {
+        if (!file.isEmpty() && !current->files.contains(file)) {
+            scanFileTree(current->file, current->libraryPath);
+            return;
         }
     }
-    return plist;
+
+    Snapshot * snapshot = new Snapshot;
+    snapshot->file = current->file;
+    snapshot->top = current->top;
+    snapshot->libraryPath = current->libraryPath;
+    snapshot->files = current->files;
+    snapshot->files.insert(fileName, scanned);
+    linkProject(*snapshot);
+
+    setProject(QSharedPointer<const Snapshot>(snapshot));
+
+    // the project tree only needs an update if the objects changed
+    if (project->spinFiles != current->spinFiles)
+        emit projectScanned(project->file);
+}
+
+/* replace the project symbols with the result of the current scan */
+void SpinParser::publishScan()
+{
+    if (!currentScan)
+        return;
+
+    QSharedPointer<Scan> scan = currentScan;
+
+    scan->mutex.lock();
+    bool done = scan->done;
+    if (done)
+        setProject(scan->result);
+    scan->mutex.unlock();
+
+    // an older scan finished, the current one is still busy
+    if (!done)
+        return;
+
+    currentScan.clear();
+    reportDiagnostics();
+    emit projectScanned(scan->file);
+}
+
+/* tell the user about problems found while linking the project */
+void SpinParser::reportDiagnostics()
+{
+    if (!project->diagnostics.isEmpty())
+        emit sendMessage(project->diagnostics.join("; "));
 }
 
 /*
- * these are convenience wrappers for typefilter
+ *   SYMBOL LISTS
  */
-QStringList SpinParser::spinConstants(QString file, QString objname)
+
+int SpinParser::SymbolList::count() const
 {
-    QStringList list;
-    QStringList keys = db.keys();
-    QString key;
-    QString value;
-    for(int n = 0; n < keys.length(); n++) {
-        key = keys[n];
-        value = db[key];
-        if(objname.length() > 0) {
-            if(key.contains(objname+":",Qt::CaseInsensitive)) {
-                QStringList tabs = value.split("\t");
-                if(tabs.count() > 2) {
-                    if(QString(tabs.at(3)).contains("c",Qt::CaseInsensitive))
-                        list.append(tagItem(tabs,2));
-                    else if(QString(tabs.at(3)).contains("e",Qt::CaseInsensitive)) {
-                        list.append(tagItem(tabs,0));
-                    }
-                }
-            }
-        }
-        else if(value.contains(file,Qt::CaseInsensitive)) {
-            QStringList tabs = value.split("\t");
-            if(tabs.count() > 2) {
-                if(QString(tabs.at(3)).contains("c",Qt::CaseInsensitive))
-                    list.append(tagItem(tabs,2));
-                else if(QString(tabs.at(3)).contains("e",Qt::CaseInsensitive)) {
-                    list.append(tagItem(tabs,0));
-                }
-            }
-        }
+    return symbols.count();
+}
+
+bool SpinParser::SymbolList::isEmpty() const
+{
+    return symbols.isEmpty();
+}
+
+QChar SpinParser::SymbolList::kind(int n) const
+{
+    return QChar(letters.at(snapshot->symbols.kind(symbols.at(n))));
+}
+
+QString SpinParser::SymbolList::name(int n) const
+{
+    const SpinSymbolTable & table = snapshot->symbols;
+    return table.string(table.name(symbols.at(n)));
+}
+
+QString SpinParser::SymbolList::declaration(int n) const
+{
+    const SpinSymbolTable & table = snapshot->symbols;
+    return table.string(table.declaration(symbols.at(n)));
+}
+
+QString SpinParser::SymbolList::file(int n) const
+{
+    const SpinSymbolTable & table = snapshot->symbols;
+    return table.string(table.file(symbols.at(n)));
+}
+
+int SpinParser::SymbolList::line(int n) const
+{
+    return snapshot->symbols.line(symbols.at(n));
+}
+
+int SpinParser::SymbolList::column(int n) const
+{
+    return snapshot->symbols.column(symbols.at(n));
+}
+
+int SpinParser::SymbolList::endLine(int n) const
+{
+    return snapshot->symbols.end(symbols.at(n));
+}
+
+/* build the tag item of entry n in the format of its query */
+QString SpinParser::SymbolList::at(int n) const
+{
+    QString s(kind(n));
+    s += '\t';
+    switch (format) {
+        case ITEM_DECLARATION:
+            s += declaration(n);
+            break;
+        case ITEM_CONSTANT:
+            s += kind(n) == 'e' ? name(n) : declaration(n);
+            break;
+        case ITEM_METHOD:
+            s += declaration(n);
+            s += '\t';
+            s += kind(n);
+            s += '\t';
+            s += QString::number(line(n));
+            break;
+        case ITEM_NAME:
+            s += name(n);
+            break;
     }
-    return list;
+    return s;
 }
 
-QStringList SpinParser::spinMethods(QString file, QString objname)
+QStringList SpinParser::SymbolList::toStringList() const
 {
     QStringList list;
-    QStringList keys = db.keys();
-    QString key;
-    QString value;
-    for(int n = 0; n < keys.length(); n++) {
-        key = keys[n];
-        value = db[key];
-        if(objname.length() > 0) {
-            if(key.contains(objname+":",Qt::CaseInsensitive)) {
-                QStringList tabs = value.split("\t");
-                if(tabs.count() > 2) {
-                    if(QString(tabs.at(3)).contains("p",Qt::CaseInsensitive))
-                        list.append(tagItem(tabs,2)+"\t"+tagItem(tabs,4));
-                    if(QString(tabs.at(3)).contains("f",Qt::CaseInsensitive))
-                        list.append(tagItem(tabs,2)+"\t"+tagItem(tabs,4));
-                }
-            }
+    for (int n = 0; n < count(); n++)
+        list.append(at(n));
+    return list;
+}
+
+/*
+ * orders file ids by path.
+ */
+struct FilePathOrder
+{
+    const SpinSymbolTable & table;
+
+    FilePathOrder(const SpinSymbolTable & t) : table(t) {}
+
+    bool operator()(int a, int b) const
+    {
+        return table.string(a) < table.string(b);
+    }
+};
+
+/*
+ * collect the ids of all files visible to a query, ordered by path.
+ * with an object name, these are the files behind every object node
+ * instantiated under that name. without one, these are the files whose
+ * path contains file.
+ */
+QVector<int> SpinParser::findFiles(QString file, QString objname)
+{
+    const SpinSymbolTable & symbols = project->symbols;
+    QVector<int> files;
+
+    if (objname.length() > 0) {
+        // obj[n] refers to the same object as obj
+        if (objname.indexOf('[') > 0)
+            objname = objname.left(objname.indexOf('['));
+
+        // several instances of one object share the same symbols
+        foreach (int node, symbols.nodesNamed(objname.trimmed())) {
+            int id = symbols.nodeFile(node);
+            if (!files.contains(id))
+                files.append(id);
         }
-        else if(value.contains(file,Qt::CaseInsensitive)) {
-            QStringList tabs = value.split("\t");
-            if(tabs.count() > 2) {
-                if(QString(tabs.at(3)).contains("p",Qt::CaseInsensitive))
-                    list.append(tagItem(tabs,2)+"\t"+tagItem(tabs,4));
-                if(QString(tabs.at(3)).contains("f",Qt::CaseInsensitive))
-                    list.append(tagItem(tabs,2)+"\t"+tagItem(tabs,4));
-                if(QString(tabs.at(3)).contains("o",Qt::CaseInsensitive))
-                    list.append(tagItem(tabs,2)+"\t"+tagItem(tabs,4));
-            }
+    }
+    else {
+        foreach (int id, symbols.fileList()) {
+            if (symbols.string(id).contains(file, Qt::CaseInsensitive))
+                files.append(id);
         }
     }
-    return list;
+
+    std::sort(files.begin(), files.end(), FilePathOrder(symbols));
+    return files;
 }
 
-QStringList SpinParser::spinDat(QString objname)
+/*
+ * list the symbols of files, kind by kind in the order given.
+ * within a kind, symbols come by file, then by name, the way the link
+ * step stored them, so the list is built in a single pass.
+ */
+SpinParser::SymbolList SpinParser::findSymbols(QVector<int> files, QList<SpinKind> kinds, ItemFormat format)
 {
-    QStringList list;
-    QStringList keys = db.keys();
-    QString key;
-    QString value;
-    for(int n = 0; n < keys.length(); n++) {
-        key = keys[n];
-        value = db[key];
-        if(key.contains(objname+":",Qt::CaseInsensitive)) {
-            QStringList tabs = value.split("\t");
-            if(tabs.count() > 2) {
-                if(QString(tabs.at(3)).contains("d",Qt::CaseInsensitive))
-                    list.append(tagItem(tabs,2));
+    SymbolList list;
+    list.snapshot = project;
+    list.letters = kindLetters;
+    list.format = format;
+
+    foreach (SpinKind kind, kinds) {
+        foreach (int file, files) {
+            foreach (const SpinSymbolTable::Range & r, project->symbols.kindRanges(file, kind)) {
+                for (int sym = r.begin; sym < r.end; sym++)
+                    list.symbols.append(sym);
             }
         }
     }
     return list;
 }
 
-QStringList SpinParser::spinVars(QString objname)
+/*
+ * all symbols are accessible by key.
+ * a key is a name list such as "/root/obj/subobj/subsubobj"
+ * if the key is empty, return the root or top file list
+ */
+SpinParser::SymbolList SpinParser::spinSymbols(QString file, QString objname)
+{
+    // objects first, then methods, constants and data
+    return findSymbols(findFiles(file, objname),
+            QList<SpinKind>() << K_OBJECT << K_PUB << K_PRI << K_CONST << K_ENUM << K_VAR << K_DAT,
+            ITEM_DECLARATION);
+}
+
+/*
+ * these are convenience wrappers for typefilter
+ */
+SpinParser::SymbolList SpinParser::spinConstants(QString file, QString objname)
 {
-    QStringList list;
-    QStringList keys = db.keys();
-    QString key;
-    QString value;
-    for(int n = 0; n < keys.length(); n++) {
-        key = keys[n];
-        value = db[key];
-        if(key.contains(objname+":",Qt::CaseInsensitive)) {
-            QStringList tabs = value.split("\t");
-            if(tabs.count() > 2) {
-                if(QString(tabs.at(3)).contains("v",Qt::CaseInsensitive))
-                    list.append(tagItem(tabs,2));
-            }
-        }
-    }
+    return findSymbols(findFiles(file, objname),
+            QList<SpinKind>() << K_CONST << K_ENUM,
+            ITEM_CONSTANT);
+}
+
+SpinParser::SymbolList SpinParser::spinMethods(QString file, QString objname)
+{
+    // objects come last and only for the top level
+    QList<SpinKind> kinds;
+    kinds << K_PUB << K_PRI;
+    if (objname.length() == 0)
+        kinds << K_OBJECT;
+
+    return findSymbols(findFiles(file, objname), kinds, ITEM_METHOD);
+}
+
+SpinParser::SymbolList SpinParser::spinDat(QString objname)
+{
+    return findSymbols(findFiles("", objname), QList<SpinKind>() << K_DAT, ITEM_DECLARATION);
+}
+
+SpinParser::SymbolList SpinParser::spinVars(QString objname)
+{
+    return findSymbols(findFiles("", objname), QList<SpinKind>() << K_VAR, ITEM_DECLARATION);
+}
+
+SpinParser::SymbolList SpinParser::spinObjects(QString objname)
+{
+    return findSymbols(findFiles("", objname), QList<SpinKind>() << K_OBJECT, ITEM_DECLARATION);
+}
+
+SpinParser::SymbolList SpinParser::spinLocals(QString file, int line)
+{
+    SymbolList list;
+    list.snapshot = project;
+    list.letters = kindLetters;
+    list.format = ITEM_NAME;
+
+    const SpinSymbolTable & symbols = project->symbols;
+    int id = symbols.find(file);
+    if (id >= 0)
+        list.symbols = symbols.members(symbols.scopeAt(id, line));
     return list;
 }
 
-QStringList SpinParser::spinObjects(QString objname)
+SpinParser::SymbolList SpinParser::spinDefinition(QString file, int line, QString name, QString objname)
 {
-    QStringList list;
-    QStringList keys = db.keys();
-    QString key;
-    QString value;
-    for(int n = 0; n < keys.length(); n++) {
-        key = keys[n];
-        value = db[key];
-        if(key.contains(objname+":",Qt::CaseInsensitive)) {
-            QStringList tabs = value.split("\t");
-            if(tabs.count() > 2) {
-                if(QString(tabs.at(3)).contains("o",Qt::CaseInsensitive))
-                    list.append(tagItem(tabs,2));
-            }
+    SymbolList list;
+    list.snapshot = project;
+    list.letters = kindLetters;
+    list.format = ITEM_DECLARATION;
+
+    const SpinSymbolTable & symbols = project->symbols;
+
+    // another object only shows its file scope
+    if (objname.length() > 0) {
+        foreach (int id, findFiles("", objname)) {
+            int sym = symbols.lookup(id, name);
+            if (sym >= 0)
+                list.symbols.append(sym);
         }
+        return list;
     }
+
+    int id = symbols.find(file);
+    if (id < 0)
+        return list;
+
+    int sym = symbols.lookupLocal(symbols.scopeAt(id, line), name);
+    if (sym < 0)
+        sym = symbols.lookup(id, name);
+    if (sym >= 0)
+        list.symbols.append(sym);
     return list;
 }
 
 /*
- *   FUNCTION DEFINITIONS
+ *   CONSTANT VALUES
  */
 
-/* Match the name of a tag (function, variable, type, ...) starting at pos. */
-char const *SpinParser::extract_name (char const *pos, QString &name)
+/* looks the names of an expression up in the file it is declared in */
+class SpinParser::ConstantResolver : public SpinExpression::Resolver
 {
-    while (isspace (*pos))
-        pos++;
-    name.clear();
-    for (; *pos && !isspace (*pos) && *pos != '(' && *pos != ','; pos++)
-        name.append(*pos);
-    return pos;
-}
+public:
+    ConstantResolver(SpinParser * parser, QString file, QSet<QString> & files, QSet<QString> & pending)
+        : parser(parser), file(file), files(files), pending(pending)
+    {
+    }
 
-int SpinParser::tokentype(QString tmp)
+    SpinExpression::Value constant(const QString & object, const QString & name)
+    {
+        QString target = object.isEmpty() ? file : parser->instanceFile(file, object);
+        if (target.isEmpty())
+            return SpinExpression::invalid();
+        return parser->constantValue(target, name, files, pending);
+    }
+
+private:
+    SpinParser * parser;
+    QString file;
+    QSet<QString> & files;
+    QSet<QString> & pending;
+};
+
+/* the file behind the object called instance in file, empty if there is none */
+QString SpinParser::instanceFile(QString file, QString instance)
 {
-    int rc = K_NONE;
-    int i;
-    /* find out token type for parser states */
-    if(tmp.indexOf(' ') > 0) {
-        tmp = tmp.mid(0,tmp.indexOf(' '));
+    // obj[n] is the same object as obj
+    if (instance.indexOf('[') > 0)
+        instance = instance.left(instance.indexOf('['));
+    instance = instance.trimmed();
+
+    QHash<QString, ScannedFile>::const_iterator i = project->files.constFind(file);
+    if (i == project->files.constEnd())
+        return QString();
+
+    const ScannedFile & scanned = i.value();
+    int object = 0;
+    foreach (const FileSymbol & sym, scanned.record.symbols) {
+        if (sym.kind != K_OBJECT)
+            continue;
+        if (sym.name.compare(instance, Qt::CaseInsensitive) == 0)
+            return scanned.objects.at(object);
+        object++;
     }
-    for (i = 0; spin_keywords[i].token != NULL; i++)
-    {
-        if (tmp.compare(spin_keywords[i].token,Qt::CaseInsensitive) == 0) {
-            rc = spin_keywords[i].kind;
-            break;
-        }
+    return QString();
+}
+
+/*
+ * the value of constant name in file. files gets the files it was
+ * read from, pending holds the constants being worked out, so one
+ * that depends on itself ends instead of going round forever.
+ */
+SpinExpression::Value SpinParser::constantValue(QString file, QString name,
+        QSet<QString> & files, QSet<QString> & pending)
+{
+    QString key = file + '\n' + name.toLower();
+    files.insert(file);
+
+    QHash<QString, ConstantValue>::const_iterator c = constants.constFind(key);
+    if (c != constants.constEnd()) {
+        files.unite(c.value().files);
+        return c.value().value;
     }
-    return rc;
+
+    if (pending.contains(key))
+        return SpinExpression::invalid();
+
+    const SpinSymbolTable & symbols = project->symbols;
+    int id = symbols.find(file);
+    int sym = id < 0 ? -1 : symbols.lookup(id, name);
+    if (sym < 0 || symbols.expression(sym) < 0)
+        return SpinExpression::invalid();
+
+    ConstantValue value;
+    value.files.insert(file);
+
+    pending.insert(key);
+    ConstantResolver resolver(this, file, value.files, pending);
+    value.value = SpinExpression::evaluate(symbols.string(symbols.expression(sym)), resolver);
+    pending.remove(key);
+
+    constants.insert(key, value);
+    files.unite(value.files);
+    return value.value;
 }
 
-/* Match a keyword starting at p (case insensitive). */
-int SpinParser::match_keyword (const char *p, KeyWord const *kw, QString &tag)
+QString SpinParser::spinConstantValue(QString file, QString name, QString objname)
+{
+    if (objname.length() > 0)
+        file = instanceFile(file, objname);
+    if (file.isEmpty())
+        return QString();
+
+    QSet<QString> files;
+    QSet<QString> pending;
+    return SpinExpression::toString(constantValue(file, name, files, pending));
+}
+
+/*
+ * orders search matches best first. on a tie the shorter name wins,
+ * then the one that comes first.
+ */
+struct MatchOrder
 {
-    QString name;
-    int i;
-    int j;
-    int rc = K_NONE;
-    char *tmp = (char*)p;
+    const SpinSymbolTable & table;
 
-    for (i = 0; i < kw->token.length(); i++)
+    MatchOrder(const SpinSymbolTable & t) : table(t) {}
+
+    bool operator()(const SpinSymbolTable::Match & a, const SpinSymbolTable::Match & b) const
     {
-        if (tolower (p[i]) != kw->token[i])
-            return rc;
+        if (a.score != b.score)
+            return a.score > b.score;
+
+        const QString & nameA = table.string(table.name(a.symbol));
+        const QString & nameB = table.string(table.name(b.symbol));
+        if (nameA.length() != nameB.length())
+            return nameA.length() < nameB.length();
+        return a.symbol < b.symbol;
     }
+};
+
+SpinParser::SymbolList SpinParser::spinSearch(QString pattern, int limit)
+{
+    SymbolList list;
+    list.snapshot = project;
+    list.letters = kindLetters;
+    list.format = ITEM_DECLARATION;
 
-    p += i;
-    if(*p && !isspace(*p))
-        return K_NONE;
+    if (pattern.isEmpty())
+        return list;
 
-    /* if p stands alone on the line, don't add it */
-    if(strlen(p) == 0)
-         return tokentype(tmp);
+    const SpinSymbolTable & symbols = project->symbols;
+    QVector<SpinSymbolTable::Match> matches = symbols.search(pattern);
 
-    for (j = 0; j < 1 + kw->skip; j++)
-    {
-        p = extract_name (p, name);
-    }
-    /* printf ("match_keyword name %d %s\n", name->length, name->buffer); */
-
-    if(name.length() > 0) {
-        rc = tokentype(kw->token);
-        tag = name+"\t"+currentFile+"\t"+tmp+"\t"+SpinKinds[rc].letter;
-    }
-    return rc;
-}
-
-void SpinParser::match_constant (QString p, int line)
-{
-    QString tag("");
-    int len;
-    bool ok;
-    p = p.trimmed();
-    // ENUM is a constant like #n, NAME, NAME2
-    if((p.indexOf("#")) == 0) {
-        // add to database
-        QString s = p.mid(1).trimmed();
-        QStringList list = s.split(",");
-        for(int n = 0; n < list.count(); n++) {
-            s = QString(list[n]).trimmed();
-            s.toInt(&ok);  // don't add numbers to the list
-            if(ok == true) continue;
-            tag = s+"\t"+currentFile+"\t"+p+"\t"+"e";
-            QString key = objectNode+KEY_ELEMENT_SEP+s;
-            if(db.contains(key) == false)
-                db.insert(key,tag+"\t"+QString("%1").arg(line));
-            // qDebug() << objectNode << " ## " << tag;
+    // only the best ones are put in order
+    int count = limit > 0 ? qMin(limit, matches.count()) : matches.count();
+    std::partial_sort(matches.begin(), matches.begin() + count, matches.end(), MatchOrder(symbols));
+
+    for (int n = 0; n < count; n++)
+        list.symbols.append(matches.at(n).symbol);
+    return list;
+}
+
+QList<SpinParser::Reference> SpinParser::spinReferences(QString file, int line, QString name, QString objname)
+{
+    QList<Reference> list;
+
+    SymbolList definition = spinDefinition(file, line, name, objname);
+    if (definition.isEmpty())
+        return list;
+
+    const SpinSymbolTable & symbols = definition.snapshot->symbols;
+    int sym = definition.symbols.first();
+    int home = symbols.file(sym);
+    int scope = symbols.scope(sym);
+
+    foreach (int ref, symbols.references(name)) {
+        int refFile = symbols.referenceFile(ref);
+        int refLine = symbols.referenceLine(ref);
+        int target = symbols.referenceTarget(ref);
+
+        if (scope >= 0) {
+            // a local is only seen inside its method or DAT label
+            if (refFile != home || target != -1
+                    || refLine < symbols.line(scope) || refLine > symbols.end(scope))
+                continue;
         }
-    }
-    else if((len = p.indexOf("=")) > 0) {
-        if(p.contains(QRegExp("\\b?=\\b")))
-            len = 0;
-        if(len > 0) {
-            // add to database
-            QString s = p.mid(0,len).trimmed();
-            if(s.indexOf("con",0,Qt::CaseInsensitive) == 0)
-                s = s.mid(4);
-            s = s.trimmed();
-            tag = s+"\t"+currentFile+"\t"+p+"\t"+SpinKinds[K_CONST].letter;
-            QString key = objectNode+KEY_ELEMENT_SEP+s;
-            if(db.contains(key) == false)
-                db.insert(key,tag+"\t"+QString("%1").arg(line));
-            // qDebug() << objectNode << " ## " << tag;
+        else if (target != home) {
+            // used in its own file, unless a local of the same name hides it
+            if (refFile != home || target != -1
+                    || symbols.lookupLocal(symbols.scopeAt(home, refLine), name) >= 0)
+                continue;
         }
+
+        Reference r = { symbols.string(refFile), refLine, symbols.referenceColumn(ref) };
+        list.append(r);
     }
+    return list;
 }
 
-void SpinParser::match_dat (QString p, int line)
-{
-    QString tag = "";
-    QString s = p.trimmed();
-    if(s.indexOf("dat",0,Qt::CaseInsensitive) == 0)
-        s = s.mid(4);
-    s = s.trimmed();
-    QRegExp regex("\\b(byte|long|word|org)\\b");
-    regex.setCaseSensitivity(Qt::CaseInsensitive);
-    if(s.contains(regex)) {
-        s = s.mid(0,s.indexOf(regex));
-        s = s.trimmed();
-        QStringList list = s.split(",",QString::SkipEmptyParts);
-        if(list.length() > 0) {
-            foreach(s,list) {
-                if(s.contains("["))
-                    s = s.mid(0,s.indexOf("["));
-                s = s.trimmed();
-                tag = s+"\t"+currentFile+"\t"+p+"\t"+SpinKinds[K_DAT].letter;
-                QString key = objectNode+KEY_ELEMENT_SEP+s;
-                if(db.contains(key) == false)
-                    db.insert(key,tag+"\t"+QString("%1").arg(line));
-                // qDebug() << objectNode << " DAT " << tag;
-            }
+/*
+ *   FUNCTION DEFINITIONS
+ */
+
+/* get the section a line starts, or K_NONE. In Spin, keywords always are at the start of the line. */
+SpinParser::SpinKind SpinParser::tokentype(const SpinTokenizer & tok)
+{
+    switch (tok.keyword(0)) {
+        case SpinKeyword::KW_CON: return K_CONST;
+        case SpinKeyword::KW_OBJ: return K_OBJECT;
+        case SpinKeyword::KW_PUB: return K_PUB;
+        case SpinKeyword::KW_PRI: return K_PRI;
+        case SpinKeyword::KW_VAR: return K_VAR;
+        case SpinKeyword::KW_DAT: return K_DAT;
+        default: return K_NONE;
+    }
+}
+
+/* add the name token n, returns its index in the record */
+int SpinParser::addSymbol(FileRecord & record, const SpinTokenizer & tok, int n,
+        SpinKind kind, QString declaration, int scope)
+{
+    FileSymbol sym;
+    sym.name = tok.text(n).toString();
+    sym.kind = kind;
+    sym.declaration = declaration;
+    sym.line = tok.line();
+    sym.column = tok.token(n).pos - tok.lineStart();
+    sym.end = sym.line;
+    sym.scope = scope;
+
+    record.symbols.append(sym);
+    return record.symbols.count()-1;
+}
+
+/*
+ * add the leading name of every comma separated item between tokens
+ * from and to, such as a, b[4], c. commas inside brackets don't count.
+ */
+void SpinParser::match_names (FileRecord & record, const SpinTokenizer & tok, int from, int to,
+        SpinKind kind, QString declaration, int scope)
+{
+    bool item = true;
+    int nesting = 0;
+
+    for (int n = from; n < to; n++) {
+        if (tok.isOperator(n, "[") || tok.isOperator(n, "(")) {
+            nesting++;
         }
+        else if (tok.isOperator(n, "]") || tok.isOperator(n, ")")) {
+            if (nesting > 0)
+                nesting--;
+        }
+        else if (nesting == 0 && tok.isOperator(n, ",")) {
+            item = true;
+            continue;
+        }
+
+        if (item && tok.token(n).type == SpinTokenizer::T_NAME)
+            addSymbol(record, tok, n, kind, declaration, scope);
+        item = false;
     }
 }
 
-void SpinParser::match_object (QString p, int line)
-{
-    int len = p.indexOf(":");
-    if(p.indexOf(":=") > 0)
-        len = 0;
-    if(len > 0) {
-        // add to database
-        QString s = p.mid(0,len);
-        if(s.contains("OBJ",Qt::CaseInsensitive))
-            s = s.mid(s.indexOf("OBJ",0,Qt::CaseInsensitive)+3);
-        if(s.contains("[",Qt::CaseInsensitive))
-            s = s.mid(0,s.indexOf("[",0,Qt::CaseInsensitive));
-        s = s.trimmed();
-        if(p.contains("OBJ",Qt::CaseInsensitive))
-            p = p.mid(p.indexOf("OBJ",0,Qt::CaseInsensitive)+3);
-        if(s.contains("[",Qt::CaseInsensitive))
-            p = p.mid(0,p.indexOf("[",0,Qt::CaseInsensitive));
-        p = p.trimmed();
-
-        QString key = objectNode+KEY_ELEMENT_SEP+s;
-        QString tag = s+"\t"+currentFile+"\t"+p+"\t"+SpinKinds[K_OBJECT].letter;
-        QString dummy, subnode, subfile, parent, curr = key;
-
-        objectInfo(tag, subnode, subfile, parent);
-        QString file = checkFile(subfile);
-
-		// file is missing, ignore object
-        if(!QFile::exists(file)) return;
-			
-		// avoid circular references, do this by scanning all existing
-		// parents of this particular key (*/*/*:*)
-		for (;;) {
-			int index;
-			// invalid match, ignore object
-			if (parent == file) {
-				qDebug() << "circular reference: " << s << currentFile;
-				return;
-			}
-			// cut off key at KEY_ELEMENT_SEP
-			if ((index = curr.lastIndexOf(KEY_ELEMENT_SEP)) == -1) break;
-			curr.resize(index);
-			// replace last / with KEY_ELEMENT_SEP
-			if ((index = curr.lastIndexOf('/')) == -1) break;
-			curr[index] = QChar(KEY_ELEMENT_SEP);
-			// extract parent file
-			objectInfo(db[curr], dummy, dummy, parent);
-		}
-        if(!db.contains(key))
-            db.insert(key,tag+"\t"+QString("%1").arg(line));
-
-        findSpinTags(subfile,objectNode+"/"+subnode);
-    }
-}
-
-void SpinParser::match_pri (QString p, int line)
-{
-    QString tag("");
-    int len = p.indexOf("pri",0,Qt::CaseInsensitive);
-    if(len == 0) {
-        // add to database
-        QString s = p.mid(4);
-        if(s.indexOf("|") >= 0)
-            s = s.mid(0,s.indexOf("|"));
-        if(s.indexOf(":") >= 0)
-            s = s.mid(0,s.indexOf(":"));
-        if(s.indexOf("(") >= 0)
-            s = s.mid(0,s.indexOf("("));
-        s = s.trimmed();
-        tag = s+"\t"+currentFile+"\t"+p+"\t"+SpinKinds[K_PRI].letter;
-        QString key = objectNode+KEY_ELEMENT_SEP+s;
-        if(db.contains(key) == false)
-            db.insert(key,tag+"\t"+QString("%1").arg(line));
-        // qDebug() << objectNode << " pri " << tag;
-    }
-}
-
-void SpinParser::match_pub (QString p, int line)
-{
-    QString tag("");
-    int len = p.indexOf("pub",0,Qt::CaseInsensitive);
-    if(len == 0) {
-        // add to database
-        QString s = p.mid(4);
-        if(s.indexOf("|") >= 0)
-            s = s.mid(0,s.indexOf("|"));
-        if(s.indexOf(":") >= 0)
-            s = s.mid(0,s.indexOf(":"));
-        if(s.indexOf("(") >= 0)
-            s = s.mid(0,s.indexOf("("));
-        s = s.trimmed();
-        tag = s+"\t"+currentFile+"\t"+p+"\t"+SpinKinds[K_PUB].letter;
-        QString key = objectNode+KEY_ELEMENT_SEP+s;
-        if(db.contains(key) == false)
-            db.insert(key,tag+"\t"+QString("%1").arg(line));
-        // qDebug() << objectNode << " pub " << tag;
-    }
-}
-
-void SpinParser::match_var (QString p, int line)
-{
-    QString tag = "";
-    QString s = p.trimmed();
-    if(s.indexOf("var",0,Qt::CaseInsensitive) == 0)
-        s = s.mid(4);
-    s = s.trimmed();
-    QRegExp regex("\\b(byte|long|word)\\b");
-    regex.setCaseSensitivity(Qt::CaseInsensitive);
-    if(s.contains(regex)) {
-        QString s = p.trimmed();
-        if(s.indexOf("var",0,Qt::CaseInsensitive) == 0)
-            s = s.mid(4);
-        s = s.trimmed();
-        if(s.indexOf(regex) == 0) {
-            s = s.mid(s.indexOf(regex)+4);
-            QStringList list = s.split(",",QString::SkipEmptyParts);
-            if(list.length() > 0) {
-                foreach(s,list) {
-                    if(s.contains("["))
-                        s = s.mid(0,s.indexOf("["));
-                    s = s.trimmed();
-                    tag = s+"\t"+currentFile+"\t"+p+"\t"+SpinKinds[K_VAR].letter;
-                    QString key = objectNode+KEY_ELEMENT_SEP+s;
-                    if(db.contains(key) == false)
-                        db.insert(key,tag+"\t"+QString("%1").arg(line));
-                    // qDebug() << objectNode << " VAR " << tag;
+/*
+ * a CON line holds comma separated items. NAME = value declares a
+ * constant, #n starts an enumeration at n and each NAME or NAME[step]
+ * after it takes the next value. every symbol keeps its value as an
+ * expression, it is worked out once the project is linked.
+ */
+void SpinParser::match_constant (FileRecord & record, const SpinTokenizer & tok, int first)
+{
+    if (first >= tok.count())
+        return;
+
+    QString declaration = tok.code(0);
+    QString start;      // the enumeration start, empty outside of one
+    int offset = 0;     // added to start for the next enumeration value
+
+    int from = first;
+    while (from < tok.count()) {
+        int to = from;
+        int nesting = 0;
+        for (; to < tok.count(); to++) {
+            if (tok.isOperator(to, "[") || tok.isOperator(to, "("))
+                nesting++;
+            else if (tok.isOperator(to, "]") || tok.isOperator(to, ")"))
+                nesting--;
+            else if (nesting <= 0 && tok.isOperator(to, ","))
+                break;
+        }
+
+        if (tok.isOperator(from, "#") && to > from+1) {
+            start = tok.code(from+1, to);
+            offset = 0;
+        }
+        else if (tok.token(from).type == SpinTokenizer::T_NAME) {
+            if (tok.isOperator(from+1, "=") && to > from+2) {
+                int sym = addSymbol(record, tok, from, K_CONST, declaration);
+                record.symbols[sym].expression = tok.code(from+2, to);
+            }
+            else if (!start.isEmpty()) {
+                int sym = addSymbol(record, tok, from, K_ENUM, declaration);
+                record.symbols[sym].expression = offset ? "(" + start + ") + " + QString::number(offset) : start;
+
+                // NAME[step] skips step values instead of one
+                bool ok = true;
+                int step = 1;
+                if (tok.isOperator(from+1, "[") && to > from+3 && tok.isOperator(to-1, "]")) {
+                    step = (to == from+4) ? tok.text(from+2).toString().toInt(&ok) : 0;
+                    if (!ok || to != from+4) {
+                        start = "(" + start + ") + " + QString::number(offset) + " + (" + tok.code(from+2, to-1) + ")";
+                        offset = step = 0;
+                    }
                 }
+                offset += step;
             }
         }
+        from = to+1;
+    }
+}
+
+/*
+ * a DAT line starts with a label unless its first word is reserved,
+ * such as label long 1, label mov a, #2 or label res 4. a label that
+ * starts with a colon is local to the label before it.
+ * returns the index of a new global label, or -1.
+ */
+int SpinParser::match_dat (FileRecord & record, const SpinTokenizer & tok, int first, int scope)
+{
+    if (first >= tok.count())
+        return -1;
+
+    if (tok.isOperator(first, ":") && first+1 < tok.count()
+            && tok.token(first+1).type == SpinTokenizer::T_NAME
+            && tok.token(first+1).pos == tok.token(first).pos+1) {
+        int label = addSymbol(record, tok, first+1, K_DAT, tok.code(0), scope);
+        record.symbols[label].name.prepend(":");
+        record.symbols[label].column--;
+        return -1;
+    }
+
+    if (tok.token(first).type != SpinTokenizer::T_NAME || tok.keyword(first) != SpinKeyword::KW_NONE)
+        return -1;
+
+    return addSymbol(record, tok, first, K_DAT, tok.code(0));
+}
+
+void SpinParser::match_object (FileRecord & record, const SpinTokenizer & tok, int first)
+{
+    // name : "file" or name[n] : "file"
+    if (first >= tok.count() || tok.token(first).type != SpinTokenizer::T_NAME)
+        return;
+
+    for (int n = first+1; n < tok.count(); n++) {
+        if (tok.isOperator(n, ":=")) {
+            return;
+        }
+        if (tok.isOperator(n, ":")) {
+            addSymbol(record, tok, first, K_OBJECT, tok.code(first));
+            return;
+        }
     }
 }
 
-int SpinParser::objectInfo(QString tag, QString &name, QString &file)
+/*
+ * PUB or PRI name(param, param) : result | local, local[n]
+ * only the PUB or PRI line itself declares a method.
+ * returns the index of the method, or -1.
+ */
+int SpinParser::match_method (FileRecord & record, const SpinTokenizer & tok, int first, SpinKind kind)
 {
-	return objectInfo(tag, name, file, file);
+    if (first == 0 || first >= tok.count() || tok.token(first).type != SpinTokenizer::T_NAME)
+        return -1;
+
+    QString declaration = tok.code(0);
+    int method = addSymbol(record, tok, first, kind, declaration);
+
+    int n = first+1;
+    if (tok.isOperator(n, "(")) {
+        int close = n+1;
+        while (close < tok.count() && !tok.isOperator(close, ")"))
+            close++;
+        match_names(record, tok, n+1, close, K_PARAM, declaration, method);
+        n = close+1;
+    }
+
+    if (tok.isOperator(n, ":") && n+1 < tok.count() && tok.token(n+1).type == SpinTokenizer::T_NAME) {
+        addSymbol(record, tok, n+1, K_RESULT, declaration, method);
+        n += 2;
+    }
+
+    if (tok.isOperator(n, "|"))
+        match_names(record, tok, n+1, tok.count(), K_LOCAL, declaration, method);
+
+    return method;
 }
 
-int SpinParser::objectInfo(QString tag, QString &name, QString &file, QString &parent)
+void SpinParser::match_var (FileRecord & record, const SpinTokenizer & tok, int first)
+{
+    // byte|word|long name, name[n]
+    if (SpinKeyword::isSize(tok.keyword(first)))
+        match_names(record, tok, first+1, tok.count(), K_VAR, tok.code(0));
+}
+
+/* true if token n starts right where token n-1 ends */
+static bool isAdjacent(const SpinTokenizer & tok, int n)
+{
+    return tok.token(n).pos == tok.token(n-1).pos + tok.token(n-1).length;
+}
+
+/*
+ * record every name of a line that isn't a reserved word. words holds
+ * the names seen so far, so a file keeps one copy of each.
+ */
+void SpinParser::match_references (FileRecord & record, const SpinTokenizer & tok, SpinKind state,
+        QSet<QString> & words)
 {
-    QStringList list = tag.split("\t",QString::KeepEmptyParts);
-    if(list.length() == 0)
-        return 0;
+    for (int n = 0; n < tok.count(); n++) {
+        if (tok.token(n).type != SpinTokenizer::T_NAME || tok.keyword(n) != SpinKeyword::KW_NONE)
+            continue;
+
+        FileReference ref;
+        ref.name = *words.insert(tok.text(n).toString());
+        ref.line = tok.line();
+        ref.column = tok.token(n).pos - tok.lineStart();
+
+        // obj.name, obj[n].name and obj#name belong to another object
+        if (n >= 2 && (tok.isOperator(n-1, ".") || tok.isOperator(n-1, "#"))
+                && isAdjacent(tok, n) && isAdjacent(tok, n-1)) {
+            int o = n-2;
+            if (tok.isOperator(o, "]")) {
+                while (o > 0 && !tok.isOperator(o, "["))
+                    o--;
+                o--;
+            }
+            if (o >= 0 && tok.token(o).type == SpinTokenizer::T_NAME && tok.keyword(o) == SpinKeyword::KW_NONE)
+                ref.object = *words.insert(tok.text(o).toString());
+        }
+        // :name is a local DAT label
+        else if (state == K_DAT && n >= 1 && tok.isOperator(n-1, ":") && isAdjacent(tok, n)) {
+            ref.name = *words.insert(":" + ref.name);
+            ref.column--;
+        }
+
+        record.references.append(ref);
+    }
+}
 
-    name = QString(list[0]).trimmed();
-    file = QString(list[2]).trimmed();
+/* get the file name from an object declaration such as name : "file" */
+QString SpinParser::objectFile(QString declaration)
+{
+    QString file = declaration.trimmed();
     file = file.mid(file.indexOf("\"")+1);
     file = file.mid(0,file.indexOf("\""));
     file = file.trimmed();
@@ -558,181 +1150,511 @@ int SpinParser::objectInfo(QString tag, QString &name, QString &file, QString &p
     if(file.contains(".spin",Qt::CaseInsensitive) == false)
         file += ".spin";
 
-	if (parent != file)
-		parent = QString(list[1]).trimmed();
-
-    return list.length();
+    return file;
 }
 
 
-QString SpinParser::checkFile(QString fileName)
+/*
+ * get the parse result of a file, or of its overlay if it has one.
+ * a file is only read again if its size or time stamp changed,
+ * and only parsed again if its contents changed as well.
+ * this is called by scan tasks, the cache is only held while
+ * looking up or storing a record, never while reading or parsing.
+ */
+bool SpinParser::loadFile(QString fileName, FileRecord & record, bool * parsed)
 {
-    QString retfile = fileName;
-    QString fs = this->currentFile;
-    QString shortfile = fileName.mid(fileName.lastIndexOf("/")+1);
-    QString path = fs.mid(0,fs.lastIndexOf("/")+1);
+    FileRecord cached;
+    bool found = false;
+
+    cacheMutex.lock();
+    QHash<QString, FileRecord>::const_iterator o = overlays.constFind(fileName);
+    if(o != overlays.constEnd()) {
+        record = o.value();
+        cacheMutex.unlock();
+        return true;
+    }
+    cacheMutex.unlock();
+
+    QFileInfo info(fileName);
+    if(!info.exists())
+        return false;
 
-    if(QFile::exists(fileName)) {
-        return fileName;
+    cacheMutex.lock();
+    QHash<QString, FileRecord>::const_iterator i = fileCache.constFind(fileName);
+    if(i != fileCache.constEnd()) {
+        cached = i.value();
+        found = true;
     }
-    else if(QFile::exists(path+fileName)) {
-        return path+fileName;
+    cacheMutex.unlock();
+
+    if(found
+            && cached.modified == info.lastModified()
+            && cached.size == info.size()) {
+        record = cached;
+        return true;
     }
-    else if(QFile::exists(libraryPath+fileName)) {
-        return libraryPath+fileName;
+
+    QFile file(fileName);
+    if(file.open(QFile::ReadOnly) != true)
+        return false;
+    QByteArray data = file.readAll();
+    file.close();
+
+    QByteArray hash = QCryptographicHash::hash(data, QCryptographicHash::Sha1);
+
+    if(found && cached.hash == hash) {
+        record = cached;
     }
     else {
-        QDir dir;
-        QStringList list;
-        dir.setPath(path);
-        list = dir.entryList();
-        foreach(QString s, list) {
-            if(s.compare(shortfile,Qt::CaseInsensitive) == 0) {
-                return path+s;
-            }
+        QTextStream in(data);
+        in.setAutoDetectUnicode(true);
+
+        record = FileRecord();
+        record.hash = hash;
+        parseText(record, in.readAll());
+
+        if(parsed)
+            *parsed = true;
+    }
+    record.modified = info.lastModified();
+    record.size = info.size();
+
+    cacheMutex.lock();
+    fileCache.insert(fileName, record);
+    cacheMutex.unlock();
+    return true;
+}
+
+QString SpinParser::indexFile()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation)+"/spinindex.dat";
+}
+
+/*
+ * fill the file cache with the library records of the last session.
+ * the index is only used if it was written for the same library path,
+ * each record is still checked against its file before it is used.
+ */
+void SpinParser::loadIndex(QString libpath)
+{
+    if(libpath.isEmpty())
+        return;
+
+    QFile file(indexFile());
+    if(file.open(QFile::ReadOnly) != true)
+        return;
+
+    // map the file instead of reading it into another buffer
+    qint64 size = file.size();
+    uchar * map = file.map(0, size);
+    if(map == NULL)
+        return;
+
+    QByteArray data = QByteArray::fromRawData((const char *) map, size);
+    QDataStream in(data);
+    in.setVersion(QDataStream::Qt_5_0);
+
+    quint32 magic, version;
+    QString path;
+    quint32 count;
+    in >> magic >> version >> path >> count;
+
+    if(magic != INDEX_MAGIC || version != INDEX_VERSION || path != libpath) {
+        file.unmap(map);
+        return;
+    }
+
+    QHash<QString, FileRecord> records;
+    for(quint32 n = 0; n < count && in.status() == QDataStream::Ok; n++) {
+        QString fileName;
+        FileRecord record;
+        quint32 symbols;
+        in >> fileName >> record.modified >> record.size >> record.hash >> symbols;
+
+        for(quint32 i = 0; i < symbols && in.status() == QDataStream::Ok; i++) {
+            FileSymbol sym;
+            quint8 kind;
+            qint32 line, column, end, scope;
+            in >> sym.name >> kind >> sym.declaration >> line >> column >> end >> scope >> sym.expression;
+            sym.kind = (SpinKind) kind;
+            sym.line = line;
+            sym.column = column;
+            sym.end = end;
+            sym.scope = scope;
+            record.symbols.append(sym);
         }
-        dir.setPath(libraryPath);
-        list = dir.entryList();
-        foreach(QString s, list) {
-            if(s.contains(shortfile,Qt::CaseInsensitive)) {
-                return libraryPath+"/"+s;
-            }
+
+        qint32 lines;
+        quint32 sections;
+        in >> lines >> sections;
+        record.lines = lines;
+
+        for(quint32 i = 0; i < sections && in.status() == QDataStream::Ok; i++) {
+            FileSection section;
+            qint32 line, symbol, reference;
+            quint8 kind;
+            in >> line >> kind >> symbol >> reference;
+            section.line = line;
+            section.kind = (SpinKind) kind;
+            section.symbol = symbol;
+            section.reference = reference;
+            record.sections.append(section);
+        }
+
+        quint32 references;
+        in >> references;
+        for(quint32 i = 0; i < references && in.status() == QDataStream::Ok; i++) {
+            FileReference ref;
+            qint32 line, column;
+            in >> ref.name >> ref.object >> line >> column;
+            ref.line = line;
+            ref.column = column;
+            record.references.append(ref);
         }
+        records.insert(fileName, record);
+    }
+    file.unmap(map);
+
+    if(in.status() != QDataStream::Ok) {
+        qDebug() << "ignoring damaged symbol index" << file.fileName();
+        return;
     }
-    return retfile;
+
+    cacheMutex.lock();
+    for(QHash<QString, FileRecord>::const_iterator i = records.constBegin(); i != records.constEnd(); ++i) {
+        if(!fileCache.contains(i.key()))
+            fileCache.insert(i.key(), i.value());
+    }
+    cacheMutex.unlock();
 }
 
-void SpinParser::findSpinTags (QString fileName, QString objnode)
+/* write the records of all cached library files to the index */
+void SpinParser::saveIndex(QString libpath)
 {
-    fileName = checkFile(fileName);
-    if(QFile::exists(fileName) == false)
-        return;
+    cacheMutex.lock();
+    QHash<QString, FileRecord> records;
+    for(QHash<QString, FileRecord>::const_iterator i = fileCache.constBegin(); i != fileCache.constEnd(); ++i) {
+        if(i.key().startsWith(libpath))
+            records.insert(i.key(), i.value());
+    }
+    cacheMutex.unlock();
 
-    QString line;
-    QString old;
-    QString tag;
-    QString filestr;
+    QMutexLocker locker(&indexMutex);
 
-    SpinKind state = K_CONST; // spin starts with CONST
-    int blockComment = 0;
+    QDir().mkpath(QFileInfo(indexFile()).path());
 
-    QFile file(fileName);
-    QTextStream in(&file);
-    in.setAutoDetectUnicode(true);
-    if(file.open(QFile::ReadOnly) != true)
+    QSaveFile file(indexFile());
+    if(file.open(QFile::WriteOnly) != true)
         return;
-    QStringList list;
 
-    filestr = in.readAll();
-    file.close();
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << (quint32) INDEX_MAGIC << (quint32) INDEX_VERSION << libpath << (quint32) records.count();
 
+    for(QHash<QString, FileRecord>::const_iterator i = records.constBegin(); i != records.constEnd(); ++i) {
+        const FileRecord & record = i.value();
+        out << i.key() << record.modified << record.size << record.hash << (quint32) record.symbols.count();
 
-    QRegExp spline("\r\n|\n\r|\r|\n");
-    spline.setCaseSensitivity(Qt::CaseInsensitive);
-    list = filestr.split(spline,QString::KeepEmptyParts);
+        foreach (const FileSymbol & sym, record.symbols) {
+            out << sym.name << (quint8) sym.kind << sym.declaration << (qint32) sym.line
+                << (qint32) sym.column << (qint32) sym.end << (qint32) sym.scope << sym.expression;
+        }
 
-    QRegExp braces("[{}]");
+        out << (qint32) record.lines << (quint32) record.sections.count();
+        foreach (const FileSection & section, record.sections) {
+            out << (qint32) section.line << (quint8) section.kind << (qint32) section.symbol
+                << (qint32) section.reference;
+        }
 
-    QRegExp sregx(
-        "\\b"
-        "con[ \t\r\n]|"
-        "dat[ \t\r\n]|"
-        "obj[ \t\r\n]|"
-        "pri[ \t\r\n]|"
-        "pub[ \t\r\n]|"
-        "var[ \t\r\n]"
-        "\\b");
+        out << (quint32) record.references.count();
+        foreach (const FileReference & ref, record.references) {
+            out << ref.name << ref.object << (qint32) ref.line << (qint32) ref.column;
+        }
+    }
 
-    sregx.setCaseSensitivity(Qt::CaseInsensitive);
+    if(!file.commit())
+        qDebug() << "can't write symbol index" << file.fileName();
+}
 
-    for(int n = 0; n < list.length(); n++)
+/*
+ * orders the symbols of a file by kind, then by name.
+ */
+struct SpinParser::FileSymbolOrder
+{
+    const QList<FileSymbol> & symbols;
+
+    FileSymbolOrder(const QList<FileSymbol> & s) : symbols(s) {}
+
+    bool operator()(int a, int b) const
     {
-        // give app a chance to do work? parsing can take a while.
-        // QApplication::processEvents();
-
-        // do here in case OBJ detect causes context change
-        objectNode  = objnode;
-        currentFile = fileName;
-
-        if(n) old = list[n-1];
-        line = QString(list[n]).trimmed();
-
-        if(line.contains(braces)) {
-            QString s = line;
-            line = "";
-            for(int j = 0; j < s.length(); j++) {
-                QChar c = s[j];
-                if(c == '{') {
-                    blockComment++;
-                }
-                else if(c == '}') {
-                    if(blockComment > 0) // should never go negative
-                        blockComment--;
-                    else
-                        qDebug() << "Negative block comment ?";
-                    if(s.trimmed().startsWith("}") && old.trimmed().endsWith("{")) {
-                        line = old.replace("{","")+s.mid(1);
-                    }
-                }
-                if(!blockComment) {
-                    if(j < s.length()) line += s[j];
-                }
-            }
-        }
+        // scoped symbols come after the methods and labels they belong to
+        bool scopedA = symbols.at(a).scope >= 0;
+        bool scopedB = symbols.at(b).scope >= 0;
+        if (scopedA != scopedB)
+            return scopedB;
+        if (symbols.at(a).kind != symbols.at(b).kind)
+            return symbols.at(a).kind < symbols.at(b).kind;
+        return symbols.at(a).name < symbols.at(b).name;
+    }
+};
 
-        if(blockComment > 0)
-            continue;
+/*
+ * link a scanned file into the snapshot under objnode,
+ * then do the same for every object it instantiates.
+ * the symbols of a file are only added the first time it is seen,
+ * later instances of it only add a node.
+ * ancestors holds the files from the top object down to this one,
+ * ancestorSet the same files for lookups.
+ */
+void SpinParser::linkSpinTags (Snapshot & snapshot, const QHash<QString, ScannedFile> & files,
+        QString fileName, QString objnode, QStringList & ancestors, QSet<QString> & ancestorSet)
+{
+    QHash<QString, ScannedFile>::const_iterator i = files.constFind(fileName);
+    if(i == files.constEnd())
+        return;
 
-        if(line.contains("\'")) {
-            line = line.mid(0,line.indexOf("\'"));
+    const ScannedFile & scanned = i.value();
+    SpinSymbolTable & symbols = snapshot.symbols;
+
+    int fileId = symbols.intern(fileName);
+    bool added = symbols.addFile(fileId);
+    symbols.addNode(symbols.intern(objnode), fileId);
+
+    ancestors.append(fileName);
+    ancestorSet.insert(fileName);
+
+    QList<ObjectRef> objects;
+    QVector<int> linked;
+    QHash<QString, QString> objectFiles;    /* lower case instance name to file */
+    int object = 0;
+
+    for (int n = 0; n < scanned.record.symbols.count(); n++) {
+        const FileSymbol & sym = scanned.record.symbols.at(n);
+        if(sym.kind != K_OBJECT) {
+            linked.append(n);
+            continue;
         }
 
-        /* Empty line? */
-        if (line.length() < 1)
+        QString file = scanned.objects.at(object++);
+
+        // file is missing, ignore object
+        if(file.isEmpty()) continue;
+
+        // an object that includes one of its own parents would never end,
+        // the instance is left out of the tree and the symbols
+        if(ancestorSet.contains(file)) {
+            QStringList cycle;
+            for(int a = ancestors.indexOf(file); a < ancestors.count(); a++)
+                cycle.append(QFileInfo(ancestors.at(a)).fileName());
+            cycle.append(QFileInfo(file).fileName());
+
+            QString message = tr("Circular object reference: %1").arg(cycle.join(" -> "));
+            if(!snapshot.diagnostics.contains(message))
+                snapshot.diagnostics.append(message);
             continue;
+        }
 
-        line = line.trimmed();
+        linked.append(n);
+        objectFiles.insert(sym.name.toLower(), file);
+
+        ObjectRef ref = { file, objnode+"/"+sym.name };
+        objects.append(ref);
+    }
 
-        /* In Spin, keywords always are at the start of the line. */
-        SpinKind type = K_NONE;
-        foreach(KeyWord kw, spin_keywords) {
-            if(kw.kind == K_NONE)
+    // store the symbols grouped by kind and sorted by name,
+    // so queries can take them range by range. a scope comes
+    // before its members, so ids maps it to its table id in time.
+    if(added) {
+        std::stable_sort(linked.begin(), linked.end(), FileSymbolOrder(scanned.record.symbols));
+        QVector<int> ids(scanned.record.symbols.count(), -1);
+        foreach (int n, linked) {
+            const FileSymbol & sym = scanned.record.symbols.at(n);
+            int scope = sym.scope >= 0 ? ids.at(sym.scope) : -1;
+            if(sym.scope >= 0 && scope < 0)
                 continue;
-            type = K_NONE;
-            if(line.indexOf(kw.token,0,Qt::CaseInsensitive) == 0) {
-                // if line has a token, get the type and store it
-                type = (SpinKind) match_keyword (line.toLatin1(), &kw, tag);
-
-                // keep state until it changes from K_NONE
-                if(type != K_NONE) {
-                    state = type;
-                    break;
-                }
+
+            ids[n] = symbols.insert(fileId, symbols.intern(sym.name),
+                    sym.kind, sym.line, symbols.intern(sym.declaration),
+                    sym.column, sym.end, scope);
+            if(ids[n] >= 0 && !sym.expression.isEmpty())
+                symbols.setExpression(ids[n], symbols.intern(sym.expression));
+        }
+
+        // obj.name is a use of name in the file behind obj
+        foreach (const FileReference & ref, scanned.record.references) {
+            int target = -1;
+            if(!ref.object.isEmpty()) {
+                QString file = objectFiles.value(ref.object.toLower());
+                if(file.isEmpty())
+                    continue;
+                target = symbols.intern(file);
             }
+            symbols.addReference(fileId, symbols.intern(ref.name), ref.line, ref.column, target);
         }
+    }
+
+    foreach (ObjectRef ref, objects) {
+        linkSpinTags(snapshot, files, ref.file, ref.node, ancestors, ancestorSet);
+    }
+
+    ancestors.removeLast();
+    ancestorSet.remove(fileName);
+}
+
+/* walk the tokens of a file line by line and collect its symbols */
+void SpinParser::parseText(FileRecord & record, QString filestr)
+{
+    SpinTokenizer tok(filestr);
 
+    record.lines = SpinTokenizer::lineCount(filestr);
+    parseSections(record, tok, K_CONST, QSet<int>()); // spin starts with CONST
+}
+
+/*
+ * parse the sections of a file that changed between base and filestr,
+ * taking the rest from base. the lines before firstLine and the last
+ * lastLines lines are the same in both. parsing starts at the last
+ * section before firstLine and stops at the first section after the
+ * change that base has as well. returns false if base can't be used.
+ */
+bool SpinParser::reparseText(FileRecord & record, const FileRecord & base, QString filestr,
+        int firstLine, int lastLines)
+{
+    int lines = SpinTokenizer::lineCount(filestr);
+    int shift = lines - base.lines;
+
+    // base has no section map or its lines don't fit the change
+    if (base.lines <= 0 || firstLine > base.lines - lastLines || firstLine > lines - lastLines)
+        return false;
+
+    int start = 0;
+    while (start < base.sections.count() && base.sections.at(start).line < firstLine)
+        start++;
+
+    // the sections before the change are kept, except the one it is in
+    int kept = start > 0 ? start-1 : 0;
+    int line = start > 0 ? base.sections.at(kept).line : 0;
+    int symbol = start > 0 ? base.sections.at(kept).symbol : 0;
+    int reference = start > 0 ? base.sections.at(kept).reference : 0;
+
+    record.lines = lines;
+    record.symbols = base.symbols.mid(0, symbol);
+    record.references = base.references.mid(0, reference);
+    record.sections = base.sections.mid(0, kept);
+
+    // sections after the change, where they are now
+    QSet<int> resync;
+    for (int n = start; n < base.sections.count(); n++) {
+        if (base.sections.at(n).line >= base.lines - lastLines)
+            resync.insert(base.sections.at(n).line + shift);
+    }
+
+    SpinTokenizer tok(filestr);
+    tok.seekLine(line);
+
+    int stop = parseSections(record, tok, K_CONST, resync);
+    if (stop < 0)
+        return true;
+
+    // the rest is the same as in base, only moved by shift lines
+    int next = start;
+    while (base.sections.at(next).line + shift != stop)
+        next++;
+
+    int offset = record.symbols.count() - base.sections.at(next).symbol;
+
+    for (int n = base.sections.at(next).symbol; n < base.symbols.count(); n++) {
+        FileSymbol sym = base.symbols.at(n);
+        sym.line += shift;
+        sym.end += shift;
+        if (sym.scope >= 0)
+            sym.scope += offset;
+        record.symbols.append(sym);
+    }
+    int moved = record.references.count() - base.sections.at(next).reference;
+
+    for (int n = base.sections.at(next).reference; n < base.references.count(); n++) {
+        FileReference ref = base.references.at(n);
+        ref.line += shift;
+        record.references.append(ref);
+    }
+    for (int n = next; n < base.sections.count(); n++) {
+        FileSection section = base.sections.at(n);
+        section.line += shift;
+        section.symbol += offset;
+        section.reference += moved;
+        record.sections.append(section);
+    }
+    return true;
+}
+
+/*
+ * collect symbols from the tokenizer's line on, starting in state.
+ * returns the line of the first section in resync it gets to without
+ * parsing it, or -1 at the end of the file.
+ */
+int SpinParser::parseSections(FileRecord & record, SpinTokenizer & tok, SpinKind state, const QSet<int> & resync)
+{
+    int scope = -1; // the method or DAT label lines belong to
+    int last = -1;  // the last line with tokens
+    QSet<QString> words;
+
+    while (tok.nextLine())
+    {
+        // keep state until a section keyword changes it
+        int first = 0;
+        SpinKind type = tokentype(tok);
+        if (type != K_NONE) {
+            // a scope ends with its section
+            if (scope >= 0)
+                record.symbols[scope].end = last;
+            scope = -1;
+
+            // at column 0 the keyword can't be inside a block comment,
+            // so parsing can start or stop here
+            if (tok.token(0).pos == tok.lineStart()) {
+                if (resync.contains(tok.line()))
+                    return tok.line();
+
+                FileSection section = { tok.line(), type, record.symbols.count(), record.references.count() };
+                record.sections.append(section);
+            }
+            state = type;
+            first = 1;
+        }
+
+        int opened = -1;
         switch(state) {
             case K_CONST:
-                match_constant(line, n);
+                match_constant(record, tok, first);
             break;
             case K_DAT:
-                match_dat(line, n);
+                opened = match_dat(record, tok, first, scope);
             break;
             case K_OBJECT:
-                match_object(line, n);
+                match_object(record, tok, first);
             break;
             case K_PRI:
-                match_pri(line, n);
-            break;
             case K_PUB:
-                match_pub(line, n);
+                opened = match_method(record, tok, first, state);
             break;
             case K_VAR:
-                match_var(line, n);
+                match_var(record, tok, first);
             break;
             default:
-                tag = "";
             break;
         }
+
+        if (opened >= 0) {
+            if (scope >= 0)
+                record.symbols[scope].end = last;
+            scope = opened;
+        }
+        match_references(record, tok, state, words);
+        last = tok.line();
     }
+
+    if (scope >= 0)
+        record.symbols[scope].end = last;
+    return -1;
 }
@@ -9,15 +9,37 @@
 #include <QDir>
 #include <QDebug>
 #include <QTextStream>
+#include <QDateTime>
+#include <QHash>
+#include <QSet>
+#include <QObject>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QAtomicInt>
 
-class SpinParser
+#include "SpinFileResolver.h"
+#include "SpinSymbolTable.h"
+#include "SpinTokenizer.h"
+#include "SpinExpression.h"
+
+class SpinParser : public QObject
 {
+    Q_OBJECT
+
 public:
     SpinParser();
     virtual ~SpinParser();
 
     void clearDB();
 
+    /*
+     * write the library index after a scan, on by default. a tool
+     * that shares the IDE settings turns it off, so it reads the
+     * index of the IDE but never replaces it.
+     */
+    void setIndexWritable(bool writable);
+
     /*
      *   DATA DEFINITIONS
      */
@@ -31,6 +53,9 @@ public:
         K_VAR,
         K_DAT,
         K_ENUM,
+        K_PARAM,
+        K_LOCAL,
+        K_RESULT,
         K_KINDS
     } SpinKind;
 
@@ -42,26 +67,104 @@ public:
      */
     QStringList spinFileTree(QString file, QString libpath);
 
-    /* build a tag item */
-    QString tagItem(QStringList tabs, int field);
+    /*
+     * Parse a spin project tree in the background.
+     * Each file is parsed once by its own task on a thread pool.
+     * A newer request cancels the one still running. When the scan
+     * is done, its result replaces the current symbols and
+     * projectScanned() is emitted.
+     */
+    void scanFileTree(QString file, QString libpath);
+
+    /*
+     * Use text in place of the file on disk, such as the unsaved
+     * contents of an editor. Only this file is parsed again, its
+     * symbols replace the ones it has in the current project.
+     * Scans read the overlay instead of the file as well.
+     *
+     * If the lines before firstLine and the last lastLines lines are
+     * the same as in the text given before, or in the file if there
+     * was none, only the sections between them are parsed again.
+     */
+    void setOverlay(QString fileName, QString text, int firstLine = 0, int lastLines = 0);
+
+    /* go back to the file on disk, such as when it was saved or closed */
+    void clearOverlay(QString fileName);
+
+    /* get the file list of the last parsed project tree */
+    QStringList spinFileList();
+
+    typedef struct {
+        QString node;
+        QString file;
+    } ObjectNode;
+
+    /*
+     * get the object instances of the last parsed project tree,
+     * such as root, root/obj and root/obj/subobj, parents first.
+     */
+    QList<ObjectNode> spinObjectTree();
+
+    /* the result of the query functions below, see SymbolList */
+    class SymbolList;
 
     /* parse a file for autocomplete */
-    QStringList spinSymbols(QString file, QString objname);
+    SymbolList spinSymbols(QString file, QString objname);
 
     /* parse a file for autocomplete constants */
-    QStringList spinConstants(QString file, QString objname);
+    SymbolList spinConstants(QString file, QString objname);
 
     /* parse a file for autocomplete methods */
-    QStringList spinMethods(QString file, QString objname);
+    SymbolList spinMethods(QString file, QString objname);
 
     /* parse a file for autocomplete variables */
-    QStringList spinVars(QString objname);
+    SymbolList spinVars(QString objname);
 
     /* parse a file for autocomplete dat labels*/
-    QStringList spinDat(QString objname);
+    SymbolList spinDat(QString objname);
 
     /* parse a file for autocomplete objects */
-    QStringList spinObjects(QString objname);
+    SymbolList spinObjects(QString objname);
+
+    /*
+     * the parameters, result and locals of the method at line of file,
+     * or the local labels of the DAT label there. items are k\tname.
+     */
+    SymbolList spinLocals(QString file, int line);
+
+    /*
+     * where name, as used at line of file, is declared. with objname
+     * the name is one of that object, otherwise locals come first.
+     * a local DAT label name starts with a colon.
+     */
+    SymbolList spinDefinition(QString file, int line, QString name, QString objname);
+
+    /*
+     * the value of constant name in file, or of obj#name if objname is
+     * the object obj of file, such as 80000000 for _clkfreq. empty if
+     * it isn't a constant or its value needs more than CON sections.
+     */
+    QString spinConstantValue(QString file, QString name, QString objname);
+
+    /*
+     * the project symbols whose names hold the characters of pattern
+     * in order, best match first, at most limit of them. a limit of 0
+     * or less lists them all.
+     */
+    SymbolList spinSearch(QString pattern, int limit);
+
+    typedef struct {
+        QString file;
+        int line;
+        int column;
+    } Reference;
+
+    /*
+     * every place the symbol name, as used at line of file, appears in
+     * the project, its declaration included. files come in the order
+     * they were linked, top file first, lines in order.
+     */
+    QList<Reference> spinReferences(QString file, int line, QString name, QString objname);
 
     typedef struct {
         QString name;
@@ -70,6 +173,13 @@ public:
         int     type;
     } Tags;
 
+signals:
+    void projectScanned(QString file);
+    void sendMessage(const QString & message);
+
+private slots:
+    void publishScan();
+
 private:
 
     typedef struct sKindOption {
@@ -79,51 +189,215 @@ private:
         QString description;    /* displayed in --help output */
     } kindOption;
 
+    kindOption SpinKinds[K_KINDS];
+
+    /* an OBJ instance waiting to be linked */
+    typedef struct {
+        QString file;
+        QString node;
+    } ObjectRef;
+
+    /* a symbol as declared in a file, before it is linked to a node */
     typedef struct {
-        QString token;
+        QString name;
         SpinParser::SpinKind kind;
-        int skip;
-    } KeyWord;
+        QString declaration;
+        int line;
+        int column;
+        int end;                /* last line of a method or DAT label */
+        int scope;              /* index of the enclosing symbol, or -1 */
+        QString expression;     /* the value of a constant */
+    } FileSymbol;
 
-    kindOption SpinKinds[K_KINDS];
-    QList<KeyWord> spin_keywords;
+    /* a name as used in a file, such as obj.method or a local */
+    typedef struct {
+        QString name;
+        QString object;         /* obj of obj.name or obj#name, else empty */
+        int line;
+        int column;
+    } FileReference;
+
+    /* a section that starts with its keyword at column 0, such as PUB */
+    typedef struct {
+        int line;
+        SpinParser::SpinKind kind;
+        int symbol;             /* its first symbol in FileRecord::symbols */
+        int reference;          /* its first reference in FileRecord::references */
+    } FileSection;
+
+    /* the parse result of one file */
+    typedef struct {
+        QDateTime modified;
+        qint64 size;
+        QByteArray hash;
+        QList<FileSymbol> symbols;
+        QList<FileReference> references;
+        int lines;
+        QVector<FileSection> sections;
+    } FileRecord;
+
+    /*
+     * Parse results of every file seen so far, keyed by path.
+     * A record is reused as long as the file's time stamp, size
+     * or content hash say it hasn't changed.
+     */
+    QHash<QString, FileRecord> fileCache;
+    QMutex cacheMutex;
+
+    /* files whose text was given by setOverlay(), also held by cacheMutex */
+    QHash<QString, FileRecord> overlays;
 
-    /* this holds the spin project file list */
-    QStringList spinFiles;
+    /*
+     * Library records are kept in an index file in the cache directory,
+     * so a new session starts with the library already parsed.
+     * indexDirty is set when a scan parsed a library file.
+     */
+    QString indexFile();
+    void loadIndex(QString libpath);
+    void saveIndex(QString libpath);
 
-    /* this holds the current working spin file */
-    QString     currentFile;
+    QMutex indexMutex;
+    QAtomicInt indexDirty;
+    bool indexWritable;
 
-    /* this holds the current working tree node */
-    QString     objectNode;
+    /* a file read by a scan, with the resolved path of each of its objects */
+    typedef struct {
+        FileRecord record;
+        QStringList objects;    /* empty if the object file is missing */
+    } ScannedFile;
 
     /*
-     * This holds a list of all project symbols.
-     * The key is a name-path key such as root/obj/subobj/subsubobj/name
-     * The items in the string list contain tag information.
-     * A tag is composed as:
-     * symbol\tfile\tdeclaration\tsymboltype
+     * The result of a project scan. It is never changed once built,
+     * a new scan or overlay replaces it as a whole.
+     *
+     * symbols holds all project symbols. A symbol is addressed by
+     * its object node such as root/obj/subobj and its name. Every
+     * symbol also records the file it was declared in, its kind,
+     * its declaration line text and its line number.
      */
-    QMap<QString, QString> db;
+    typedef struct {
+        QString file;
+        QString top;                /* file as resolved */
+        QString libraryPath;
+        QStringList spinFiles;
+        SpinSymbolTable symbols;
+        QStringList diagnostics;    /* problems found while linking */
+        QHash<QString, ScannedFile> files;  /* what symbols was linked from */
+    } Snapshot;
+
+    QSharedPointer<const Snapshot> project;
+
+    /* replace project, dropping the constant values it changes */
+    void setProject(QSharedPointer<const Snapshot> snapshot);
+
+    /*
+     * Constant values worked out so far, keyed by file and lower case
+     * name. Each value lists the files its expression was read from,
+     * so a new project only drops the values of the files it changed.
+     * Only used by the thread the queries run on.
+     */
+    typedef struct {
+        SpinExpression::Value value;
+        QSet<QString> files;
+    } ConstantValue;
+
+    QHash<QString, ConstantValue> constants;
+
+    class ConstantResolver;
+    SpinExpression::Value constantValue(QString file, QString name,
+            QSet<QString> & files, QSet<QString> & pending);
+    QString instanceFile(QString file, QString instance);
+
+    class Scan;
+    class ScanTask;
+
+    /* the background scan whose result will be published next */
+    QSharedPointer<Scan> currentScan;
+
+    SpinFileResolver resolver;
+
+    QThreadPool pool;
+
+    /* how the items of a symbol list are formatted */
+    typedef enum {
+        ITEM_DECLARATION,   /* k\tdeclaration */
+        ITEM_CONSTANT,      /* k\tdeclaration, or k\tname for enums */
+        ITEM_METHOD,        /* k\tdeclaration\tk\tline */
+        ITEM_NAME           /* k\tname */
+    } ItemFormat;
+
+    /* one letter per SpinKind, as used in tag items */
+    QByteArray kindLetters;
+
+    struct FileSymbolOrder;
+
+public:
+    /*
+     * The result of a symbol query.
+     * It only holds symbol ids and shares the project snapshot they
+     * belong to, tag items are built when they are asked for.
+     */
+    class SymbolList
+    {
+    public:
+        int count() const;
+        bool isEmpty() const;
+
+        /* tag item n, such as "f\tPUB start" */
+        QString at(int n) const;
+        QString operator[](int n) const { return at(n); }
+
+        QChar   kind(int n) const;
+        QString name(int n) const;
+        QString declaration(int n) const;
+        QString file(int n) const;
+        int     line(int n) const;
+        int     column(int n) const;
+        int     endLine(int n) const;
+
+        QStringList toStringList() const;
+
+    private:
+        friend class SpinParser;
 
-    QString     libraryPath;
+        QSharedPointer<const Snapshot> snapshot;
+        QVector<int> symbols;
+        QByteArray letters;
+        ItemFormat format;
+    };
 
 private:
 
     void setKind(kindOption *kind, bool en, const char letter, const char *type, const char *desc);
 
-    const char *extract_name (char const *pos, QString &name);
-    int  tokentype(QString tmp);
-    int  match_keyword (const char *p, KeyWord const *kw, QString &tag);
-    int  spintype(char const *p);
-    void match_constant (QString p, int line);
-    void match_dat (QString p, int line);
-    void match_object (QString p, int line);
-    void match_pri (QString p, int line);
-    void match_pub (QString p, int line);
-    void match_var (QString p, int line);
-    int objectInfo(QString tag, QString &name, QString &file);
-    int objectInfo(QString tag, QString &name, QString &file, QString &parent);
-    QString checkFile(QString fileName);
-    void findSpinTags (QString fileName, QString objnode);
+    SpinKind tokentype(const SpinTokenizer & tok);
+    void match_names (FileRecord & record, const SpinTokenizer & tok, int from, int to,
+            SpinKind kind, QString declaration, int scope = -1);
+    void match_constant (FileRecord & record, const SpinTokenizer & tok, int first);
+    int  match_dat (FileRecord & record, const SpinTokenizer & tok, int first, int scope);
+    void match_object (FileRecord & record, const SpinTokenizer & tok, int first);
+    int  match_method (FileRecord & record, const SpinTokenizer & tok, int first, SpinKind kind);
+    void match_var (FileRecord & record, const SpinTokenizer & tok, int first);
+    void match_references (FileRecord & record, const SpinTokenizer & tok, SpinKind state,
+            QSet<QString> & words);
+    int  addSymbol(FileRecord & record, const SpinTokenizer & tok, int n,
+            SpinKind kind, QString declaration, int scope = -1);
+    QVector<int> findFiles(QString file, QString objname);
+    SymbolList findSymbols(QVector<int> files, QList<SpinKind> kinds, ItemFormat format);
+    QString objectFile(QString declaration);
+    bool loadFile(QString fileName, FileRecord & record, bool * parsed = 0);
+    void parseText(FileRecord & record, QString filestr);
+    bool reparseText(FileRecord & record, const FileRecord & base, QString filestr,
+            int firstLine, int lastLines);
+    int  parseSections(FileRecord & record, SpinTokenizer & tok, SpinKind state, const QSet<int> & resync);
+    QSharedPointer<Scan> startScan(QString file, QString libpath);
+    void startTask(QSharedPointer<Scan> scan, QString fileName);
+    void scanFile(QSharedPointer<Scan> scan, QString fileName);
+    void finishScan(QSharedPointer<Scan> scan);
+    void resolveObjects(ScannedFile & scanned, QString fileName, QString libpath);
+    void linkProject(Snapshot & snapshot);
+    void updateProject(QString fileName, const FileRecord & record);
+    void linkSpinTags (Snapshot & snapshot, const QHash<QString, ScannedFile> & files,
+            QString fileName, QString objnode, QStringList & ancestors, QSet<QString> & ancestorSet);
+    void reportDiagnostics();
 };
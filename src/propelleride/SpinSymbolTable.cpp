@@ -0,0 +1,310 @@
+#include "SpinSymbolTable.h"
+
+SpinSymbolTable::SpinSymbolTable()
+{
+}
+
+void SpinSymbolTable::clear()
+{
+    pool.clear();
+    poolIndex.clear();
+
+    names.clear();
+    files.clear();
+    kinds.clear();
+    lines.clear();
+    declarations.clear();
+    columns.clear();
+    ends.clear();
+    scopes.clear();
+
+    searchable.clear();
+    searchMasks.clear();
+    searchNames.clear();
+
+    refFiles.clear();
+    refLines.clear();
+    refColumns.clear();
+    refTargets.clear();
+
+    keys.clear();
+    localKeys.clear();
+
+    fileSet.clear();
+    kindIndex.clear();
+    fileOrder.clear();
+    nodeIndex.clear();
+    nodeOrder.clear();
+    instanceIndex.clear();
+    scopeIndex.clear();
+    fileScopes.clear();
+    referenceIndex.clear();
+    expressions.clear();
+}
+
+int SpinSymbolTable::intern(const QString & s)
+{
+    QHash<QString, int>::const_iterator i = poolIndex.constFind(s);
+    if (i != poolIndex.constEnd())
+        return i.value();
+
+    int id = pool.count();
+    pool.append(s);
+    poolIndex.insert(s, id);
+    return id;
+}
+
+int SpinSymbolTable::find(const QString & s) const
+{
+    return poolIndex.value(s, -1);
+}
+
+const QString & SpinSymbolTable::string(int id) const
+{
+    return pool.at(id);
+}
+
+quint64 SpinSymbolTable::key(int file, int name)
+{
+    return ((quint64) (quint32) file << 32) | (quint32) name;
+}
+
+bool SpinSymbolTable::addFile(int file)
+{
+    if (fileSet.contains(file))
+        return false;
+
+    fileSet.insert(file);
+    fileOrder.append(file);
+    return true;
+}
+
+int SpinSymbolTable::insert(int file, int name, int kind, int line, int declaration,
+        int column, int end, int scope)
+{
+    int lower = intern(pool.at(name).toLower());
+    quint64 k = scope < 0 ? key(file, lower) : key(scope, lower);
+    QHash<quint64, int> & index = scope < 0 ? keys : localKeys;
+    if (index.contains(k))
+        return -1;
+
+    addFile(file);
+
+    int sym = names.count();
+    names.append(name);
+    files.append(file);
+    kinds.append((quint8) kind);
+    lines.append(line);
+    declarations.append(declaration);
+    columns.append(column);
+    ends.append(end < line ? line : end);
+    scopes.append(scope);
+
+    index.insert(k, sym);
+
+    if (scope < 0) {
+        extend(kindIndex[key(file, kind)], sym);
+
+        searchable.append(sym);
+        searchMasks.append(charMask(pool.at(lower)));
+        searchNames.append(lower);
+    }
+    else {
+        QVector<int> & members = scopeIndex[scope];
+        if (members.isEmpty())
+            fileScopes[file].append(scope);
+        members.append(sym);
+    }
+
+    return sym;
+}
+
+/* grow the last range if sym follows it, otherwise start a new one */
+void SpinSymbolTable::extend(RangeList & ranges, int sym)
+{
+    if (!ranges.isEmpty() && ranges.last().end == sym) {
+        ranges.last().end++;
+    }
+    else {
+        Range r = { sym, sym+1 };
+        ranges.append(r);
+    }
+}
+
+/* the pool id of the lower case name, or -1 if no symbol can have it */
+int SpinSymbolTable::folded(const QString & name) const
+{
+    return find(name.toLower());
+}
+
+void SpinSymbolTable::setExpression(int sym, int expression)
+{
+    expressions.insert(sym, expression);
+}
+
+int SpinSymbolTable::expression(int sym) const
+{
+    return expressions.value(sym, -1);
+}
+
+int SpinSymbolTable::lookup(int file, const QString & name) const
+{
+    int lower = folded(name);
+    return lower < 0 ? -1 : keys.value(key(file, lower), -1);
+}
+
+int SpinSymbolTable::lookupLocal(int scope, const QString & name) const
+{
+    int lower = folded(name);
+    return lower < 0 ? -1 : localKeys.value(key(scope, lower), -1);
+}
+
+QVector<int> SpinSymbolTable::members(int scope) const
+{
+    return scopeIndex.value(scope);
+}
+
+int SpinSymbolTable::scopeAt(int file, int line) const
+{
+    foreach (int scope, fileScopes.value(file)) {
+        if (line >= lines[scope] && line <= ends[scope])
+            return scope;
+    }
+    return -1;
+}
+
+int SpinSymbolTable::count() const
+{
+    return names.count();
+}
+
+void SpinSymbolTable::addNode(int node, int file)
+{
+    if (nodeIndex.contains(node))
+        return;
+
+    nodeIndex.insert(node, file);
+    nodeOrder.append(node);
+
+    const QString & path = pool.at(node);
+    QString instance = path.mid(path.lastIndexOf('/')+1).toLower();
+    instanceIndex[instance].append(node);
+}
+
+int SpinSymbolTable::nodeFile(int node) const
+{
+    return nodeIndex.value(node, -1);
+}
+
+const QVector<int> & SpinSymbolTable::nodeList() const
+{
+    return nodeOrder;
+}
+
+const SpinSymbolTable::RangeList & SpinSymbolTable::kindRanges(int file, int kind) const
+{
+    static const RangeList none;
+    QHash<quint64, RangeList>::const_iterator i = kindIndex.constFind(key(file, kind));
+    return i != kindIndex.constEnd() ? i.value() : none;
+}
+
+QVector<int> SpinSymbolTable::nodesNamed(const QString & name) const
+{
+    return instanceIndex.value(name.toLower());
+}
+
+const QVector<int> & SpinSymbolTable::fileList() const
+{
+    return fileOrder;
+}
+
+void SpinSymbolTable::addReference(int file, int name, int line, int column, int target)
+{
+    int lower = intern(pool.at(name).toLower());
+
+    referenceIndex[lower].append(refFiles.count());
+    refFiles.append(file);
+    refLines.append(line);
+    refColumns.append(column);
+    refTargets.append(target);
+}
+
+QVector<int> SpinSymbolTable::references(const QString & name) const
+{
+    int lower = folded(name);
+    return lower < 0 ? QVector<int>() : referenceIndex.value(lower);
+}
+
+/* one bit per letter, digit and underscore, the rest share one */
+quint64 SpinSymbolTable::charMask(const QString & lower)
+{
+    quint64 mask = 0;
+    for (int i = 0; i < lower.length(); i++) {
+        ushort c = lower.at(i).unicode();
+        if (c >= 'a' && c <= 'z')
+            mask |= (quint64) 1 << (c - 'a');
+        else if (c >= '0' && c <= '9')
+            mask |= (quint64) 1 << (26 + c - '0');
+        else if (c == '_')
+            mask |= (quint64) 1 << 36;
+        else
+            mask |= (quint64) 1 << 37;
+    }
+    return mask;
+}
+
+/*
+ * match pattern against name from left to right, -1 if it doesn't.
+ * each character found counts, more so at the start of the name or
+ * of a word, such as after _ or at an upper case letter, and more so
+ * right after the one before.
+ */
+int SpinSymbolTable::score(const QString & name, const QString & lower, const QString & pattern)
+{
+    int total = 0;
+    int previous = -2;
+    int p = 0;
+
+    for (int i = 0; i < lower.length() && p < pattern.length(); i++) {
+        if (lower.at(i) != pattern.at(p))
+            continue;
+
+        int s = 1;
+        if (i == 0)
+            s += 8;
+        else if (name.at(i-1) == '_' || (name.at(i).isUpper() && !name.at(i-1).isUpper()))
+            s += 6;
+        if (previous == i-1)
+            s += 4;
+
+        total += s;
+        previous = i;
+        p++;
+    }
+
+    if (p < pattern.length())
+        return -1;
+    if (lower.length() == pattern.length())
+        total += 16;
+    return total;
+}
+
+QVector<SpinSymbolTable::Match> SpinSymbolTable::search(const QString & pattern) const
+{
+    QVector<Match> matches;
+    QString lower = pattern.toLower();
+    quint64 mask = charMask(lower);
+
+    for (int n = 0; n < searchable.count(); n++) {
+        if ((searchMasks.at(n) & mask) != mask)
+            continue;
+
+        int sym = searchable.at(n);
+        int s = score(pool.at(names.at(sym)), pool.at(searchNames.at(n)), lower);
+        if (s >= 0) {
+            Match m = { sym, s };
+            matches.append(m);
+        }
+    }
+    return matches;
+}
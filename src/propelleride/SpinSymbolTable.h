@@ -0,0 +1,180 @@
+#pragma once
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+#include <QSet>
+
+/*
+ * Columnar symbol store used by SpinParser.
+ *
+ * Names, file paths, object nodes and declaration lines are interned
+ * once into a string pool. Each symbol is a row of integers spread over
+ * parallel vectors, so queries can walk the table without splitting or
+ * building temporary strings.
+ *
+ * Symbols belong to the file that declares them. Every distinct file is
+ * added once, no matter how many times it is instantiated; object nodes
+ * such as root/obj/subobj only refer to the file they were built from.
+ *
+ * Every file scope symbol also keeps the set of characters in its name,
+ * so a fuzzy search only scores the names that can match at all.
+ *
+ * References are the places names are used, declarations included.
+ * They are kept in rows of their own and indexed by lower case name,
+ * so all uses of a name are found without reading any file.
+ */
+class SpinSymbolTable
+{
+public:
+    /* a run of symbol ids, begin inclusive, end exclusive */
+    typedef struct {
+        int begin;
+        int end;
+    } Range;
+
+    typedef QVector<Range> RangeList;
+
+    SpinSymbolTable();
+
+    void clear();
+
+    /* add a string to the pool (if needed) and return its id */
+    int intern(const QString & s);
+
+    /* return the id of a pooled string or -1 if it was never interned */
+    int find(const QString & s) const;
+
+    const QString & string(int id) const;
+
+    /* register a file, returns false if its symbols were already added */
+    bool addFile(int file);
+
+    /*
+     * Add a symbol to the table. A file only holds one symbol per name,
+     * so -1 is returned if the name was already declared in the file.
+     * A symbol with a scope, such as a local of the method symbol scope,
+     * only has to be unique in that scope and is not part of kindRanges().
+     * Names are compared case insensitive, like Spin does.
+     */
+    int insert(int file, int name, int kind, int line, int declaration,
+            int column = 0, int end = -1, int scope = -1);
+
+    /* the expression a constant is declared with, as a pooled string */
+    void setExpression(int sym, int expression);
+    int expression(int sym) const;
+
+    /* find the file scope symbol called name in file, or -1 */
+    int lookup(int file, const QString & name) const;
+
+    /* find the symbol called name in scope, or -1 */
+    int lookupLocal(int scope, const QString & name) const;
+
+    /* all symbols of scope, in the order they were added */
+    QVector<int> members(int scope) const;
+
+    /* the symbol whose lines hold line of file and which has members, or -1 */
+    int scopeAt(int file, int line) const;
+
+    int count() const;
+
+    /* attach an object node such as root/obj/subobj to its file */
+    void addNode(int node, int file);
+
+    /* the file an object node was built from, or -1 */
+    int nodeFile(int node) const;
+
+    /* all object nodes, in the order they were added */
+    const QVector<int> & nodeList() const;
+
+    /*
+     * symbol ranges of one kind in a source file. a file whose symbols
+     * were inserted grouped by kind has a single range per kind.
+     */
+    const RangeList & kindRanges(int file, int kind) const;
+
+    /* all object nodes whose instance name is name (case insensitive) */
+    QVector<int> nodesNamed(const QString & name) const;
+
+    /* all registered files, in the order they were added */
+    const QVector<int> & fileList() const;
+
+    /*
+     * Add a place where name is used in file. target is the file of
+     * the object the name is qualified with, such as obj.name, or -1.
+     */
+    void addReference(int file, int name, int line, int column, int target = -1);
+
+    /* all references to name (case insensitive), in the order they were added */
+    QVector<int> references(const QString & name) const;
+
+    typedef struct {
+        int symbol;
+        int score;
+    } Match;
+
+    /*
+     * All file scope symbols whose name holds the characters of pattern
+     * in order, such as gv for getValue, case insensitive. A higher
+     * score means matches at the start, at word starts and in runs.
+     */
+    QVector<Match> search(const QString & pattern) const;
+
+    int referenceFile(int ref) const    { return refFiles[ref]; }
+    int referenceLine(int ref) const    { return refLines[ref]; }
+    int referenceColumn(int ref) const  { return refColumns[ref]; }
+    int referenceTarget(int ref) const  { return refTargets[ref]; }
+
+    int name(int sym) const         { return names[sym]; }
+    int file(int sym) const         { return files[sym]; }
+    int kind(int sym) const         { return kinds[sym]; }
+    int line(int sym) const         { return lines[sym]; }
+    int declaration(int sym) const  { return declarations[sym]; }
+    int column(int sym) const       { return columns[sym]; }
+    int end(int sym) const          { return ends[sym]; }       /* last line, such as of a method */
+    int scope(int sym) const        { return scopes[sym]; }     /* enclosing symbol or -1 */
+
+private:
+    static quint64 key(int file, int name);
+    int folded(const QString & name) const;
+    static quint64 charMask(const QString & lower);
+    static int score(const QString & name, const QString & lower, const QString & pattern);
+
+    QStringList         pool;
+    QHash<QString, int> poolIndex;
+
+    QVector<int>    names;
+    QVector<int>    files;
+    QVector<quint8> kinds;
+    QVector<int>    lines;
+    QVector<int>    declarations;
+    QVector<int>    columns;
+    QVector<int>    ends;
+    QVector<int>    scopes;
+
+    QVector<int>        searchable;     /* file scope symbols */
+    QVector<quint64>    searchMasks;    /* characters in their names */
+    QVector<int>        searchNames;    /* their lower case names */
+
+    QVector<int>    refFiles;
+    QVector<int>    refLines;
+    QVector<int>    refColumns;
+    QVector<int>    refTargets;
+
+    QHash<quint64, int> keys;       /* file and lower case name */
+    QHash<quint64, int> localKeys;  /* scope and lower case name */
+
+    static void extend(RangeList & ranges, int sym);
+
+    QSet<int>                       fileSet;
+    QHash<quint64, RangeList>       kindIndex;
+    QVector<int>                    fileOrder;
+    QHash<int, int>                 nodeIndex;
+    QVector<int>                    nodeOrder;
+    QHash<QString, QVector<int> >   instanceIndex;
+    QHash<int, QVector<int> >       scopeIndex;     /* scope to members */
+    QHash<int, QVector<int> >       fileScopes;     /* file to scopes with members */
+    QHash<int, QVector<int> >       referenceIndex; /* lower case name to references */
+    QHash<int, int>                 expressions;    /* constant to its expression */
+};
@@ -0,0 +1,303 @@
+#include "SpinTokenizer.h"
+
+#include <string.h>
+
+/* operators longer than one character, longest first */
+static const char * const spin_operators[] = {
+    "<<=", ">>=", "~>=", "->=", "<-=", "><=", "#>=", "<#=", "**=", "//=",
+    "===", "<>=", "=<=", "=>=",
+    ":=", "==", "<>", "=<", "=>", "->", "<-", "~>", "><", "..", "**", "//",
+    "#>", "<#", "^^", "||", "~~", "<<", ">>", "++", "--", "|<", ">|",
+    "+=", "-=", "*=", "/=", "&=", "|=", "^=",
+    NULL
+};
+
+static bool isHexDigit(QChar c)
+{
+    return c.isDigit() || (c.toLower() >= QLatin1Char('a') && c.toLower() <= QLatin1Char('f'));
+}
+
+SpinTokenizer::SpinTokenizer(const QString & text)
+    : buffer(text),
+      data(text.constData()),
+      length(text.length()),
+      pos(0),
+      lineNumber(-1),
+      nextNumber(0),
+      startPos(0),
+      depth(0),
+      doc(false),
+      comment(false)
+{
+}
+
+bool SpinTokenizer::endOfLine() const
+{
+    return data[pos] == '\n' || data[pos] == '\r';
+}
+
+/* a line ends with \r\n, \n\r, \r or \n */
+void SpinTokenizer::skipEndOfLine()
+{
+    if (pos >= length)
+        return;
+
+    QChar c = data[pos++];
+    if (pos < length && data[pos] != c && (data[pos] == '\n' || data[pos] == '\r'))
+        pos++;
+}
+
+/*
+ * { } comments nest, so { a { b } c } closes properly. a {{ }} doc
+ * comment only ends at }} and nests other {{ }} only, single braces
+ * inside it are text. this is how SyntaxLexer colors them too.
+ */
+void SpinTokenizer::skipBlockComment()
+{
+    const char * open = doc ? "{{" : "{";
+    const char * close = doc ? "}}" : "}";
+
+    while (pos < length && !endOfLine()) {
+        if (startsWith(open)) {
+            depth++;
+            pos += strlen(open);
+        }
+        else if (startsWith(close)) {
+            pos += strlen(close);
+            if (--depth == 0)
+                return;
+        }
+        else {
+            pos++;
+        }
+    }
+}
+
+bool SpinTokenizer::startsWith(const char * s) const
+{
+    int len = strlen(s);
+    if (pos + len > length)
+        return false;
+    for (int i = 0; i < len; i++)
+        if (data[pos+i] != QLatin1Char(s[i]))
+            return false;
+    return true;
+}
+
+bool SpinTokenizer::nextLine()
+{
+    while (pos < length) {
+        tokens.clear();
+        lineNumber = nextNumber++;
+        startPos = pos;
+        comment = false;
+
+        while (pos < length && !endOfLine()) {
+            if (depth > 0) {
+                skipBlockComment();
+                continue;
+            }
+
+            QChar c = data[pos];
+            if (c == '{') {
+                doc = startsWith("{{");
+                depth = 1;
+                pos += doc ? 2 : 1;
+                comment = true;
+            }
+            else if (c == '\'') {
+                while (pos < length && !endOfLine())
+                    pos++;
+            }
+            else if (c.isSpace() || c == '}') {
+                pos++;
+            }
+            else {
+                readToken();
+            }
+        }
+        skipEndOfLine();
+
+        if (!tokens.isEmpty())
+            return true;
+    }
+
+    tokens.clear();
+    return false;
+}
+
+void SpinTokenizer::seekLine(int line)
+{
+    pos = 0;
+    lineNumber = -1;
+    nextNumber = 0;
+    depth = 0;
+    doc = false;
+    comment = false;
+    tokens.clear();
+
+    while (nextNumber < line && pos < length) {
+        while (pos < length && !endOfLine())
+            pos++;
+        skipEndOfLine();
+        nextNumber++;
+    }
+}
+
+int SpinTokenizer::lineCount(const QString & text)
+{
+    SpinTokenizer tok(text);
+    int lines = 1;
+
+    while (tok.pos < tok.length) {
+        if (tok.endOfLine()) {
+            tok.skipEndOfLine();
+            lines++;
+        }
+        else {
+            tok.pos++;
+        }
+    }
+    return lines;
+}
+
+int SpinTokenizer::operatorLength() const
+{
+    for (int i = 0; spin_operators[i] != NULL; i++) {
+        const char * op = spin_operators[i];
+        int len = strlen(op);
+        if (pos + len > length)
+            continue;
+
+        int n = 0;
+        while (n < len && data[pos+n] == QLatin1Char(op[n]))
+            n++;
+        if (n == len)
+            return len;
+    }
+    return 1;
+}
+
+void SpinTokenizer::readToken()
+{
+    Token t;
+    t.pos = pos;
+    t.comment = comment;
+
+    QChar c = data[pos];
+    QChar next = pos+1 < length ? data[pos+1] : QChar();
+
+    if (c.isLetter() || c == '_') {
+        t.type = T_NAME;
+        while (pos < length && (data[pos].isLetterOrNumber() || data[pos] == '_'))
+            pos++;
+    }
+    else if (c.isDigit()
+             || (c == '$' && isHexDigit(next))
+             || (c == '%' && (next == '%' || next == '0' || next == '1'))) {
+        // $hex, %bin, %%quaternary, decimal and float, 1_000 style groups
+        t.type = T_NUMBER;
+        pos += (c == '%' && next == '%') ? 2 : 1;
+        while (pos < length) {
+            QChar d = data[pos];
+            if (d == '.' && pos+1 < length && data[pos+1].isDigit())
+                pos++;
+            else if (d.isLetterOrNumber() || d == '_')
+                pos++;
+            else
+                break;
+        }
+    }
+    else if (c == '"') {
+        // strings can't span lines, an unterminated one ends with the line
+        t.type = T_STRING;
+        pos++;
+        while (pos < length && !endOfLine() && data[pos] != '"')
+            pos++;
+        if (pos < length && data[pos] == '"')
+            pos++;
+    }
+    else {
+        t.type = T_OPERATOR;
+        pos += operatorLength();
+    }
+
+    t.length = pos - t.pos;
+    tokens.append(t);
+    comment = false;
+}
+
+QStringRef SpinTokenizer::text(int n) const
+{
+    const Token & t = tokens.at(n);
+    return QStringRef(&buffer, t.pos, t.length);
+}
+
+bool SpinTokenizer::isName(int n, const char * word) const
+{
+    if (n >= tokens.count())
+        return false;
+
+    const Token & t = tokens.at(n);
+    if (t.type != T_NAME || t.length != (int) strlen(word))
+        return false;
+
+    for (int i = 0; i < t.length; i++) {
+        if (data[t.pos+i].toLower() != QLatin1Char(word[i]))
+            return false;
+    }
+    return true;
+}
+
+SpinKeyword::Id SpinTokenizer::keyword(int n) const
+{
+    if (n >= tokens.count())
+        return SpinKeyword::KW_NONE;
+
+    const Token & t = tokens.at(n);
+    if (t.type != T_NAME)
+        return SpinKeyword::KW_NONE;
+
+    return SpinKeyword::find(data + t.pos, t.length);
+}
+
+bool SpinTokenizer::isOperator(int n, const char * op) const
+{
+    if (n >= tokens.count())
+        return false;
+
+    const Token & t = tokens.at(n);
+    if (t.type != T_OPERATOR || t.length != (int) strlen(op))
+        return false;
+
+    for (int i = 0; i < t.length; i++) {
+        if (data[t.pos+i] != QLatin1Char(op[i]))
+            return false;
+    }
+    return true;
+}
+
+QString SpinTokenizer::code(int first, int end) const
+{
+    QString s;
+    int start = tokens.at(first).pos;
+
+    if (end < 0 || end > tokens.count())
+        end = tokens.count();
+
+    // only copy around comments, the rest is taken as it is
+    for (int n = first+1; n < end; n++) {
+        const Token & t = tokens.at(n);
+        if (!t.comment)
+            continue;
+
+        const Token & prev = tokens.at(n-1);
+        s.append(data + start, prev.pos + prev.length - start);
+        s.append(' ');
+        start = t.pos;
+    }
+
+    const Token & last = tokens.at(end-1);
+    s.append(data + start, last.pos + last.length - start);
+    return s;
+}
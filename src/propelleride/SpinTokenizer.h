@@ -0,0 +1,98 @@
+#pragma once
+
+#include <QString>
+#include <QStringRef>
+#include <QVector>
+
+#include "SpinKeyword.h"
+
+/*
+ * Single pass tokenizer for Spin source.
+ *
+ * The file buffer is walked once and handed out a line at a time.
+ * Comments are dropped and strings are kept whole, so a quote or a
+ * brace inside a string never starts a comment. Tokens are only
+ * positions in the buffer, no text is copied until it is asked for.
+ */
+class SpinTokenizer
+{
+public:
+    typedef enum {
+        T_NAME,
+        T_NUMBER,
+        T_STRING,
+        T_OPERATOR
+    } TokenType;
+
+    typedef struct {
+        TokenType type;
+        int pos;
+        int length;
+        bool comment;   /* a block comment sits between this and the previous token */
+    } Token;
+
+    SpinTokenizer(const QString & text);
+
+    /* go to the next line that has tokens, returns false at the end */
+    bool nextLine();
+
+    /* zero based number of the current line */
+    int line() const            { return lineNumber; }
+
+    /* buffer position the current line starts at */
+    int lineStart() const       { return startPos; }
+
+    /*
+     * continue at the start of a line, nextLine() returns it or the
+     * first line with tokens after it. the line must not start inside
+     * a block comment.
+     */
+    void seekLine(int line);
+
+    /* number of lines in text, a line break at the end starts an empty one */
+    static int lineCount(const QString & text);
+
+    /* number of tokens on the current line */
+    int count() const           { return tokens.count(); }
+
+    const Token & token(int n) const { return tokens.at(n); }
+
+    QStringRef text(int n) const;
+
+    /* true if token n is the name word, case insensitive */
+    bool isName(int n, const char * word) const;
+
+    /* the reserved word token n is, KW_NONE if it isn't one */
+    SpinKeyword::Id keyword(int n) const;
+
+    /* true if token n is the operator op */
+    bool isOperator(int n, const char * op) const;
+
+    /*
+     * source text from token first up to token end, or to the end of
+     * the line if end is -1, without comments
+     */
+    QString code(int first, int end = -1) const;
+
+private:
+    void skipBlockComment();
+    bool startsWith(const char * s) const;
+    void readToken();
+    int  operatorLength() const;
+    bool endOfLine() const;
+    void skipEndOfLine();
+
+    const QString & buffer;
+    const QChar * data;
+    int length;
+    int pos;
+
+    int lineNumber;
+    int nextNumber;
+    int startPos;
+    int depth;          /* nesting of the open block comment, 0 if none */
+    bool doc;           /* the open block comment is a {{ }} one */
+
+    bool comment;
+    QVector<Token> tokens;
+};
@@ -0,0 +1,92 @@
+#include "SymbolFinder.h"
+
+#include <QFileInfo>
+#include <QKeyEvent>
+#include <QVBoxLayout>
+
+/* more would not fit the list anyway */
+#define SYMBOL_LIMIT    100
+
+SymbolFinder::SymbolFinder(SpinParser * parser, QWidget *parent)
+    : QDialog(parent)
+{
+    this->parser = parser;
+
+    setWindowTitle(tr("Go to Symbol"));
+    resize(500, 300);
+
+    patternEdit = new QLineEdit(this);
+    patternEdit->installEventFilter(this);
+    resultList = new QListWidget(this);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addWidget(patternEdit);
+    layout->addWidget(resultList);
+
+    connect(patternEdit, SIGNAL(textChanged(QString)), this, SLOT(patternChanged(QString)));
+    connect(resultList, SIGNAL(itemActivated(QListWidgetItem*)), this, SLOT(itemActivated(QListWidgetItem*)));
+}
+
+void SymbolFinder::showFinder()
+{
+    patternEdit->clear();
+    resultList->clear();
+    show();
+    raise();
+    activateWindow();
+    patternEdit->setFocus();
+}
+
+void SymbolFinder::patternChanged(QString pattern)
+{
+    results = parser->spinSearch(pattern.trimmed(), SYMBOL_LIMIT);
+
+    resultList->clear();
+    for (int n = 0; n < results.count(); n++)
+    {
+        resultList->addItem(QString("%1\t%2\t%3:%4")
+                .arg(results.name(n))
+                .arg(results.kind(n))
+                .arg(QFileInfo(results.file(n)).fileName())
+                .arg(results.line(n)+1));
+    }
+    resultList->setCurrentRow(0);
+}
+
+void SymbolFinder::itemActivated(QListWidgetItem * item)
+{
+    int row = resultList->row(item);
+    if (row < 0 || row >= results.count())
+        return;
+
+    hide();
+    emit symbolSelected(results.file(row), results.line(row));
+}
+
+/* the arrow keys move through the list while typing */
+bool SymbolFinder::eventFilter(QObject *target, QEvent *event)
+{
+    if (target == patternEdit && event->type() == QEvent::KeyPress)
+    {
+        QKeyEvent *e = static_cast<QKeyEvent *>(event);
+        int row = resultList->currentRow();
+
+        switch (e->key())
+        {
+        case Qt::Key_Up:
+            resultList->setCurrentRow(qMax(row-1, 0));
+            return true;
+        case Qt::Key_Down:
+            resultList->setCurrentRow(qMin(row+1, resultList->count()-1));
+            return true;
+        case Qt::Key_Return:
+        case Qt::Key_Enter:
+            if (resultList->currentItem())
+                itemActivated(resultList->currentItem());
+            return true;
+        default:
+            break;
+        }
+    }
+    return QDialog::eventFilter(target, event);
+}
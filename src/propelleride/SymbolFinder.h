@@ -0,0 +1,41 @@
+#pragma once
+
+#include <QDialog>
+#include <QLineEdit>
+#include <QListWidget>
+
+#include "SpinParser.h"
+
+/*
+ * Finds a symbol anywhere in the project by typing part of its name.
+ *
+ * The characters typed only have to appear in order, so sfq finds
+ * setFrequency. Results come from the project index as the pattern
+ * changes, best match first.
+ */
+class SymbolFinder : public QDialog
+{
+    Q_OBJECT
+
+public:
+    SymbolFinder(SpinParser * parser, QWidget *parent = 0);
+
+signals:
+    void symbolSelected(QString file, int line);
+
+public slots:
+    void showFinder();
+
+private slots:
+    void patternChanged(QString pattern);
+    void itemActivated(QListWidgetItem * item);
+
+private:
+    bool eventFilter(QObject *target, QEvent *event);
+
+    SpinParser * parser;
+    SpinParser::SymbolList results;
+
+    QLineEdit   * patternEdit;
+    QListWidget * resultList;
+};
@@ -0,0 +1,669 @@
+#include "SyntaxLexer.h"
+
+#include <string.h>
+
+#include "Language.h"
+
+static bool isWordChar(QChar c)
+{
+    return c.isLetterOrNumber() || c == '_';
+}
+
+static void addSpan(QVector<SyntaxLexer::Span> & spans, int start, int length, SyntaxLexer::Style style)
+{
+    SyntaxLexer::Span s;
+    s.start = start;
+    s.length = length;
+    s.style = style;
+    spans.append(s);
+}
+
+/*
+ * patterns are read as far as they have the shapes the language files
+ * use, anything else makes the caller keep the regular expression.
+ */
+
+static bool isQuantifier(const QString & p, int pos)
+{
+    return pos < p.length() && (p[pos] == '*' || p[pos] == '+' || p[pos] == '?');
+}
+
+/* \b, it's only looked for at the ends of a pattern */
+static bool readBoundary(const QString & p, int & pos)
+{
+    if (pos+1 < p.length() && p[pos] == '\\' && p[pos+1] == 'b') {
+        pos += 2;
+        return true;
+    }
+    return false;
+}
+
+/* a character that stands for itself, \x or [x] */
+static bool readChar(const QString & p, int & pos, QChar & c)
+{
+    int length = p.length();
+    if (pos >= length)
+        return false;
+
+    if (p[pos] == '\\') {
+        if (pos+1 >= length || p[pos+1].isLetterOrNumber())
+            return false;
+        c = p[pos+1];
+        pos += 2;
+        return true;
+    }
+    if (p[pos] == '[' && pos+2 < length && p[pos+2] == ']'
+            && p[pos+1] != '^' && p[pos+1] != '\\') {
+        c = p[pos+1];
+        pos += 3;
+        return true;
+    }
+    if (QString("[](){}.*+?|^$").contains(p[pos]))
+        return false;
+
+    c = p[pos++];
+    return true;
+}
+
+/* stops before a character that has a quantifier */
+static QString readLiteral(const QString & p, int & pos)
+{
+    QString s;
+    QChar c;
+    int start = pos;
+
+    while (readChar(p, pos, c)) {
+        if (isQuantifier(p, pos)) {
+            pos = start;
+            break;
+        }
+        s.append(c);
+        start = pos;
+    }
+    return s;
+}
+
+static bool readClassChar(const QString & p, int & pos, QChar & c)
+{
+    if (p[pos] != '\\') {
+        c = p[pos++];
+        return true;
+    }
+    if (pos+1 >= p.length())
+        return false;
+
+    QChar e = p[pos+1];
+    if (e == 'n')
+        c = '\n';
+    else if (e.isLetterOrNumber())
+        return false;
+    else
+        c = e;
+    pos += 2;
+    return true;
+}
+
+void SyntaxLexer::addChar(CharSet & set, QChar c)
+{
+    QChar cases[2] = { c, c };
+    if (!caseSensitive) {
+        cases[0] = c.toLower();
+        cases[1] = c.toUpper();
+    }
+    for (int i = 0; i < 2; i++) {
+        ushort u = cases[i].unicode();
+        if (u < 128)
+            set.bits[u >> 6] |= (quint64) 1 << (u & 63);
+    }
+}
+
+/* [...], [^...] or . */
+bool SyntaxLexer::readClass(const QString & p, int & pos, CharSet & set)
+{
+    int length = p.length();
+    set.bits[0] = set.bits[1] = 0;
+    set.negated = false;
+
+    if (pos >= length)
+        return false;
+
+    if (p[pos] == '.') {
+        addChar(set, '\n');
+        set.negated = true;
+        pos++;
+        return true;
+    }
+    if (p[pos] != '[')
+        return false;
+
+    int n = pos+1;
+    if (n < length && p[n] == '^') {
+        set.negated = true;
+        n++;
+    }
+
+    while (n < length && p[n] != ']') {
+        QChar first, last;
+        if (!readClassChar(p, n, first))
+            return false;
+        last = first;
+        if (n+1 < length && p[n] == '-' && p[n+1] != ']') {
+            n++;
+            if (!readClassChar(p, n, last))
+                return false;
+        }
+        for (int c = first.unicode(); c <= last.unicode() && c < 128; c++)
+            addChar(set, QChar(c));
+    }
+    if (n >= length)
+        return false;
+
+    pos = n+1;
+    return true;
+}
+
+void SyntaxLexer::mark(QChar c, int cls)
+{
+    QChar cases[2] = { c, c };
+    if (!caseSensitive) {
+        cases[0] = c.toLower();
+        cases[1] = c.toUpper();
+    }
+    for (int i = 0; i < 2; i++) {
+        ushort u = cases[i].unicode();
+        if (u < 128)
+            classes[u] |= cls;
+    }
+}
+
+/* \bword\b, anything after the leading word characters is left out */
+void SyntaxLexer::addWords(const QStringList & patterns, Style style, QList<Word> & list)
+{
+    foreach (const QString & p, patterns) {
+        int pos = 0;
+        readBoundary(p, pos);
+
+        int start = pos;
+        while (pos < p.length() && isWordChar(p[pos]))
+            pos++;
+        if (pos == start)
+            continue;
+
+        Word w;
+        w.name = p.mid(start, pos - start);
+        if (!caseSensitive)
+            w.name = w.name.toLower();
+        w.style = style;
+        list.append(w);
+    }
+}
+
+void SyntaxLexer::addOperator(const QString & op)
+{
+    ushort u = op[0].unicode();
+    if (u >= 128 || isWordChar(op[0])) {
+        addFallback(QRegExp::escape(op), S_OPERATOR);
+        return;
+    }
+
+    QStringList & list = operators[u];
+    if (list.contains(op))
+        return;
+
+    int n = 0;
+    while (n < list.count() && list.at(n).length() >= op.length())
+        n++;
+    list.insert(n, op);
+    classes[u] |= C_OPERATOR;
+}
+
+/* \b?prefix[chars]*\b? or with + */
+bool SyntaxLexer::addNumber(const QString & p)
+{
+    NumberRule rule;
+    int pos = 0;
+
+    rule.start = readBoundary(p, pos);
+    rule.prefix = readLiteral(p, pos);
+    if (!readClass(p, pos, rule.chars) || rule.chars.negated)
+        return false;
+    if (pos >= p.length() || (p[pos] != '*' && p[pos] != '+'))
+        return false;
+    rule.empty = p[pos++] == '*';
+    rule.end = readBoundary(p, pos);
+
+    if (pos != p.length() || (rule.prefix.isEmpty() && rule.empty))
+        return false;
+
+    numbers.append(rule);
+
+    if (!rule.prefix.isEmpty()) {
+        mark(rule.prefix[0], C_NUMBER);
+    }
+    else {
+        for (int c = 0; c < 128; c++)
+            if (contains(rule.chars, QChar(c)))
+                classes[c] |= C_NUMBER;
+    }
+    return true;
+}
+
+/* open[^\n]* to the end of the line, or open.*close on the line */
+bool SyntaxLexer::addRegion(const QString & p, Style style)
+{
+    Region r;
+    int pos = 0;
+    CharSet any;
+
+    readBoundary(p, pos);
+    r.open = readLiteral(p, pos);
+    r.style = style;
+    if (r.open.isEmpty() || !readClass(p, pos, any) || !isQuantifier(p, pos))
+        return false;
+    pos++;
+
+    if (!any.negated || contains(any, '\n'))
+        return false;
+
+    if (pos < p.length()) {
+        r.close = readLiteral(p, pos);
+        if (r.close.isEmpty() || pos != p.length())
+            return false;
+    }
+
+    regions.append(r);
+    mark(r.open[0], C_REGION);
+    return true;
+}
+
+/* \b[chars]+(?=next)\b */
+bool SyntaxLexer::setFunction(const QString & p)
+{
+    int pos = 0;
+
+    readBoundary(p, pos);
+    if (functions || !readClass(p, pos, functionChars) || functionChars.negated)
+        return false;
+    if (pos >= p.length() || p[pos] != '+')
+        return false;
+    pos++;
+
+    if (p.mid(pos, 3) != "(?=")
+        return false;
+    pos += 3;
+    functionNext = readLiteral(p, pos);
+    if (functionNext.isEmpty() || pos >= p.length() || p[pos] != ')')
+        return false;
+    pos++;
+    readBoundary(p, pos);
+
+    functions = pos == p.length();
+    return functions;
+}
+
+void SyntaxLexer::addBlock(const QString & pair)
+{
+    QStringList ends = pair.split(' ', QString::SkipEmptyParts);
+    if (ends.count() != 2)
+        return;
+
+    Region r;
+    r.open = ends[0];
+    r.close = ends[1];
+    r.style = S_COMMENT;
+
+    int n = 0;
+    while (n < blocks.count() && blocks.at(n).open.length() >= r.open.length())
+        n++;
+    blocks.insert(n, r);
+    mark(r.open[0], C_BLOCK);
+}
+
+void SyntaxLexer::addFallback(const QString & p, Style style)
+{
+    Fallback f;
+    f.pattern = QRegExp(p, caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive);
+    f.style = style;
+    if (f.pattern.isValid())
+        fallbacks.append(f);
+}
+
+void SyntaxLexer::buildWords(const QList<Word> & list)
+{
+    int size = 16;
+    while (size < list.count() * 2)
+        size *= 2;
+
+    words.resize(size);
+    foreach (const Word & w, list) {
+        uint h = hashWord(w.name.constData(), w.name.length()) & (size-1);
+        while (!words[h].name.isEmpty() && words[h].name != w.name)
+            h = (h+1) & (size-1);
+        words[h] = w;
+    }
+}
+
+SyntaxLexer::SyntaxLexer(Language & lang)
+    : caseSensitive(lang.caseSensitive()),
+      operators(128),
+      functions(false)
+{
+    memset(classes, 0, sizeof(classes));
+    for (int c = 0; c < 128; c++)
+        if (isWordChar(QChar(c)))
+            classes[c] |= C_WORD;
+
+    // a later word replaces an earlier one, like the rules used to
+    QList<Word> list;
+    QStringList ops;
+    addWords(lang.listKeywords(), S_KEYWORD, list);
+    foreach (const QString & op, lang.listOperators()) {
+        if (op.startsWith("\\b"))
+            ops.append(op);
+        else if (!op.isEmpty())
+            addOperator(op);
+    }
+    addWords(ops, S_OPERATOR, list);
+    buildWords(list);
+
+    foreach (const QString & p, lang.listNumbers())
+        if (!addNumber(p))
+            addFallback(p, S_NUMBER);
+
+    foreach (const QString & p, lang.listFunctions())
+        if (!setFunction(p))
+            addFallback(p, S_FUNCTION);
+
+    foreach (const QString & p, lang.listComments())
+        if (!addRegion(p, S_COMMENT))
+            addFallback(p, S_COMMENT);
+
+    foreach (const QString & p, lang.listStrings())
+        if (!addRegion(p, S_STRING))
+            addFallback(p, S_STRING);
+
+    foreach (const QString & pair, lang.listBlockComments())
+        addBlock(pair);
+    nested = lang.nestedComments();
+
+    // only the character an escape starts with is used
+    QString e = lang.escape();
+    int pos = 0;
+    if (!readChar(e, pos, escape))
+        escape = QChar();
+}
+
+QChar SyntaxLexer::fold(QChar c) const
+{
+    if (caseSensitive)
+        return c;
+    ushort u = c.unicode();
+    if (u < 128)
+        return (u >= 'A' && u <= 'Z') ? QChar(u + 'a' - 'A') : c;
+    return c.toLower();
+}
+
+uint SyntaxLexer::hashWord(const QChar * s, int length) const
+{
+    uint h = 2166136261u;
+    for (int i = 0; i < length; i++)
+        h = (h ^ fold(s[i]).unicode()) * 16777619u;
+    return h;
+}
+
+/* the style of a word, -1 if it isn't one */
+int SyntaxLexer::findWord(const QChar * s, int length) const
+{
+    int mask = words.count()-1;
+    uint h = hashWord(s, length) & mask;
+
+    while (!words[h].name.isEmpty()) {
+        const Word & w = words[h];
+        if (w.name.length() == length) {
+            int i = 0;
+            while (i < length && fold(s[i]) == w.name[i])
+                i++;
+            if (i == length)
+                return w.style;
+        }
+        h = (h+1) & mask;
+    }
+    return -1;
+}
+
+bool SyntaxLexer::startsWith(const QChar * data, int length, int n, const QString & s) const
+{
+    if (n + s.length() > length)
+        return false;
+    for (int i = 0; i < s.length(); i++)
+        if (fold(data[n+i]) != fold(s[i]))
+            return false;
+    return true;
+}
+
+/*
+ * the end of block comment b at n, -1 if it's still open at the end
+ * of the line. depth is how deep it is nested, it's updated as the
+ * opens and closes of the same comment are passed.
+ */
+int SyntaxLexer::closeBlock(const QChar * data, int length, int n, const Region & b, int & depth) const
+{
+    while (n < length) {
+        if (nested && startsWith(data, length, n, b.open)) {
+            depth++;
+            n += b.open.length();
+        }
+        else if (startsWith(data, length, n, b.close)) {
+            n += b.close.length();
+            if (--depth <= 0)
+                return n;
+        }
+        else {
+            n++;
+        }
+    }
+    return -1;
+}
+
+/*
+ * the end of a string region at n, an escaped close doesn't count.
+ * -1 if the line ends first, -2 if the line ends with an escape and
+ * the string goes on.
+ */
+int SyntaxLexer::closeRegion(const QChar * data, int length, int n, const Region & r) const
+{
+    for (; n < length; n++) {
+        if (!escape.isNull() && data[n] == escape) {
+            if (++n == length)
+                return -2;
+        }
+        else if (startsWith(data, length, n, r.close)) {
+            return n + r.close.length();
+        }
+    }
+    return -1;
+}
+
+int SyntaxLexer::blockState(int block, int depth) const
+{
+    return (block + 1) | (qMin(depth, (int) MAX_DEPTH) << 8);
+}
+
+/* the end of the longest number at n, n if there is none */
+int SyntaxLexer::matchNumber(const QChar * data, int length, int n) const
+{
+    int best = n;
+
+    for (int i = 0; i < numbers.count(); i++) {
+        const NumberRule & r = numbers.at(i);
+        if (r.start && n > 0 && isWordChar(data[n-1]))
+            continue;
+        if (!startsWith(data, length, n, r.prefix))
+            continue;
+
+        int start = n + r.prefix.length();
+        int end = start;
+        while (end < length && contains(r.chars, data[end]))
+            end++;
+
+        if (end == start && !r.empty)
+            continue;
+        if (r.end && end < length && isWordChar(data[end]))
+            continue;
+        best = qMax(best, end);
+    }
+    return best;
+}
+
+int SyntaxLexer::matchFunction(const QChar * data, int length, int n) const
+{
+    int end = n;
+    while (end < length && contains(functionChars, data[end]))
+        end++;
+
+    if (end > n && startsWith(data, length, end, functionNext))
+        return end;
+    return n;
+}
+
+/* the length of the longest operator at n, 0 if there is none */
+int SyntaxLexer::matchOperator(const QChar * data, int length, int n) const
+{
+    const QStringList & list = operators.at(data[n].unicode());
+    for (int i = 0; i < list.count(); i++)
+        if (startsWith(data, length, n, list.at(i)))
+            return list.at(i).length();
+    return 0;
+}
+
+int SyntaxLexer::lex(const QString & text, int state, QVector<Span> & spans) const
+{
+    const QChar * data = text.constData();
+    int length = text.length();
+    int n = 0;
+
+    int block = (state & 0xf) - 1;
+    int region = ((state >> 4) & 0xf) - 1;
+    int depth = state >> 8;
+    state = 0;
+
+    // the rest of a comment or a string from the lines before
+    if (block >= 0 && block < blocks.count()) {
+        n = closeBlock(data, length, 0, blocks.at(block), depth);
+        if (n < 0) {
+            addSpan(spans, 0, length, S_COMMENT);
+            return blockState(block, depth);
+        }
+        addSpan(spans, 0, n, S_COMMENT);
+    }
+    else if (region >= 0 && region < regions.count()) {
+        n = closeRegion(data, length, 0, regions.at(region));
+        if (n < 0) {
+            addSpan(spans, 0, length, regions.at(region).style);
+            return (region + 1) << 4;
+        }
+        addSpan(spans, 0, n, regions.at(region).style);
+    }
+
+    while (n < length) {
+        QChar c = data[n];
+        ushort u = c.unicode();
+        int cls = u < 128 ? classes[u] : (isWordChar(c) ? C_WORD : 0);
+        int end;
+
+        if (cls & C_BLOCK) {
+            int b = 0;
+            while (b < blocks.count() && !startsWith(data, length, n, blocks.at(b).open))
+                b++;
+            if (b < blocks.count()) {
+                const Region & r = blocks.at(b);
+                depth = 1;
+                end = closeBlock(data, length, n + r.open.length(), r, depth);
+                if (end < 0) {
+                    addSpan(spans, n, length - n, S_COMMENT);
+                    state = blockState(b, depth);
+                    break;
+                }
+                addSpan(spans, n, end - n, S_COMMENT);
+                n = end;
+                continue;
+            }
+        }
+
+        if (cls & C_REGION) {
+            int i = 0;
+            while (i < regions.count() && !startsWith(data, length, n, regions.at(i).open))
+                i++;
+            if (i < regions.count()) {
+                // an unclosed string ends with the line unless it's escaped
+                const Region & r = regions.at(i);
+                end = length;
+                if (!r.close.isEmpty()) {
+                    end = closeRegion(data, length, n + r.open.length(), r);
+                    if (end < 0) {
+                        if (end == -2)
+                            state = (i + 1) << 4;
+                        end = length;
+                    }
+                }
+                addSpan(spans, n, end - n, r.style);
+                n = end;
+                continue;
+            }
+        }
+
+        if (cls & C_NUMBER) {
+            end = matchNumber(data, length, n);
+            if (end > n) {
+                addSpan(spans, n, end - n, S_NUMBER);
+                n = end;
+                continue;
+            }
+        }
+
+        if (cls & C_WORD) {
+            end = n;
+            while (end < length && isWordChar(data[end]))
+                end++;
+
+            int style = findWord(data + n, end - n);
+            if (style >= 0) {
+                addSpan(spans, n, end - n, (Style) style);
+            }
+            else if (functions) {
+                int f = matchFunction(data, length, n);
+                if (f > n) {
+                    addSpan(spans, n, f - n, S_FUNCTION);
+                    end = f;
+                }
+            }
+            n = end;
+            continue;
+        }
+
+        if (cls & C_OPERATOR) {
+            int op = matchOperator(data, length, n);
+            if (op > 0) {
+                addSpan(spans, n, op, S_OPERATOR);
+                n += op;
+                continue;
+            }
+        }
+
+        n++;
+    }
+
+    for (int i = 0; i < fallbacks.count(); i++) {
+        QRegExp expression(fallbacks.at(i).pattern);
+        int index = expression.indexIn(text);
+        while (index >= 0) {
+            int matched = expression.matchedLength();
+            if (matched == 0)
+                break;
+            addSpan(spans, index, matched, fallbacks.at(i).style);
+            index = expression.indexIn(text, index + matched);
+        }
+    }
+
+    return state;
+}
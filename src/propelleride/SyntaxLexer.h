@@ -0,0 +1,150 @@
+#pragma once
+
+#include <QChar>
+#include <QList>
+#include <QRegExp>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+class Language;
+
+/*
+ * Finds what to color in a line of source in a single pass.
+ *
+ * The rules of a language file are compiled once. Whole words go into a
+ * hash and operators into lists by their first character. Number,
+ * string, comment and function patterns become a literal prefix and a
+ * character class, so they are only tried where their first character
+ * turns up. Every character of a line is then looked at once.
+ *
+ * A pattern that doesn't have one of these shapes is kept as a regular
+ * expression and run over the line after the scan.
+ */
+class SyntaxLexer
+{
+public:
+    typedef enum {
+        S_NUMBER,
+        S_FUNCTION,
+        S_KEYWORD,
+        S_OPERATOR,
+        S_STRING,
+        S_COMMENT,
+        S_STYLES
+    } Style;
+
+    typedef struct {
+        int start;
+        int length;
+        Style style;
+    } Span;
+
+    SyntaxLexer(Language & lang);
+
+    /*
+     * append the spans of text in the order they are to be applied.
+     * state is what lex() returned for the line before, 0 for the first
+     * line. the state at the end of text is returned:
+     *
+     *   bits 0-3   block comment open at the end, its index + 1
+     *   bits 4-7   string going on to the next line, its index + 1
+     *   bits 8-    how deep the block comment is nested
+     *
+     * a line that ends with the same state as before can't change the
+     * lines after it, so rehighlighting stops there.
+     */
+    int lex(const QString & text, int state, QVector<Span> & spans) const;
+
+private:
+    /* ASCII only, no other character is ever in a class */
+    typedef struct {
+        quint64 bits[2];
+        bool negated;
+    } CharSet;
+
+    /* a literal prefix and a run of chars */
+    typedef struct {
+        QString prefix;
+        CharSet chars;
+        bool empty;         /* the run may be empty */
+        bool start;         /* starts at a word boundary */
+        bool end;           /* ends at a word boundary */
+    } NumberRule;
+
+    /* from open to close, or to the end of the line if close is empty */
+    typedef struct {
+        QString open;
+        QString close;
+        Style style;
+    } Region;
+
+    typedef struct {
+        QRegExp pattern;
+        Style style;
+    } Fallback;
+
+    typedef struct {
+        QString name;       /* lower case unless case sensitive, empty if free */
+        Style style;
+    } Word;
+
+    enum { MAX_DEPTH = 0x7fffff };
+
+    enum {
+        C_WORD      = 1,
+        C_NUMBER    = 2,
+        C_REGION    = 4,
+        C_BLOCK     = 8,
+        C_OPERATOR  = 16
+    };
+
+    bool caseSensitive;
+    uchar classes[128];
+
+    QVector<Word> words;            /* open addressing, the size is a power of two */
+    QVector<QStringList> operators; /* by first character, longest first */
+    QList<NumberRule> numbers;
+    QList<Region> regions;
+    QChar escape;                   /* skips the next character in a region, null if none */
+    QList<Region> blocks;           /* comments that may span lines, longest open first */
+    bool nested;                    /* a block comment nests in one of its kind */
+
+    bool functions;                 /* a run of functionChars followed by functionNext */
+    CharSet functionChars;
+    QString functionNext;
+
+    QList<Fallback> fallbacks;
+
+    /* compiling */
+    void mark(QChar c, int cls);
+    void addChar(CharSet & set, QChar c);
+    bool readClass(const QString & p, int & pos, CharSet & set);
+    void addWords(const QStringList & patterns, Style style, QList<Word> & list);
+    void addOperator(const QString & op);
+    bool addNumber(const QString & p);
+    bool addRegion(const QString & p, Style style);
+    bool setFunction(const QString & p);
+    void addBlock(const QString & pair);
+    void addFallback(const QString & p, Style style);
+    void buildWords(const QList<Word> & list);
+
+    /* matching */
+    QChar fold(QChar c) const;
+    uint hashWord(const QChar * s, int length) const;
+    int findWord(const QChar * s, int length) const;
+    bool startsWith(const QChar * data, int length, int n, const QString & s) const;
+    int closeBlock(const QChar * data, int length, int n, const Region & b, int & depth) const;
+    int closeRegion(const QChar * data, int length, int n, const Region & r) const;
+    int blockState(int block, int depth) const;
+    int matchNumber(const QChar * data, int length, int n) const;
+    int matchFunction(const QChar * data, int length, int n) const;
+    int matchOperator(const QChar * data, int length, int n) const;
+
+    static bool contains(const CharSet & set, QChar c)
+    {
+        ushort u = c.unicode();
+        bool in = u < 128 && ((set.bits[u >> 6] >> (u & 63)) & 1);
+        return in != set.negated;
+    }
+};
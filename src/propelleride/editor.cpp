@@ -5,14 +5,19 @@
 #include <QColor>
 #include <QPainter>
 #include <QApplication>
+#include <QHelpEvent>
+#include <QFileInfo>
+#include <QAbstractTextDocumentLayout>
 
 #include "mainwindow.h"
+#include "SpinKeyword.h"
 #define MAINWINDOW MainWindow
 
 Editor::Editor(QWidget *parent) : QPlainTextEdit(parent)
 {
     mainwindow = parent;
     propDialog = static_cast<MAINWINDOW*>(mainwindow)->propDialog;
+    spinParser = &static_cast<MAINWINDOW*>(mainwindow)->spinParser;
 
     ctrlPressed = false;
     isSpin = false;
@@ -24,6 +29,7 @@ Editor::Editor(QWidget *parent) : QPlainTextEdit(parent)
     lineNumberArea = new LineNumberArea(this);
     connect(this, SIGNAL(blockCountChanged(int)), this, SLOT(updateLineNumberAreaWidth(int)));
     connect(this, SIGNAL(updateRequest(QRect,int)), this, SLOT(updateLineNumberArea(QRect,int)));
+    connect(document()->documentLayout(), SIGNAL(documentSizeChanged(QSizeF)), this, SLOT(updateVisibleBlocks()));
     updateLineNumberAreaWidth(0);
 
     highlighter = 0;
@@ -46,6 +52,14 @@ Editor::Editor(QWidget *parent) : QPlainTextEdit(parent)
     connect(this,SIGNAL(redoAvailable(bool)), this, SLOT(setRedo(bool)));
     connect(this,SIGNAL(copyAvailable(bool)), this, SLOT(setCopy(bool)));
 
+    parseDirty = false;
+    connect(document(),SIGNAL(contentsChange(int,int,int)), this, SLOT(spinContentsChange(int,int,int)));
+
+    parseTimer.setSingleShot(true);
+    parseTimer.setInterval(500);
+    connect(this,SIGNAL(textChanged()), &parseTimer, SLOT(start()));
+    connect(&parseTimer,SIGNAL(timeout()), this, SLOT(updateSpinOverlay()));
+
     // this must be a pointer otherwise we can't control the position.
     cbAuto = new QComboBox(this);
     cbAuto->hide();
@@ -59,19 +73,79 @@ Editor::~Editor()
     delete lineNumberArea;
 }
 
+/* pick the language by the file extension, a new file is Spin */
 void Editor::setHighlights()
 {
-    if(highlighter) {
-        delete highlighter;
-        highlighter = 0;
-    }
-    highlighter = new Highlighter(this->document());
-    isSpin = true;
+    QString language = Singleton<LanguageRegistry>::Instance().languageFile(fileName);
+
+    if(highlighter)
+        highlighter->setLanguage(language);
+    else
+        highlighter = new Highlighter(this->document(), language);
+
+    isSpin = QFileInfo(language).baseName() == "spin";
 }
 
 void Editor::saveContent()
 {
     oldcontents = toPlainText();
+
+    // the file on disk is up to date again
+    parseTimer.stop();
+    parseDirty = false;
+    if (!fileName.isEmpty())
+        spinParser->clearOverlay(fileName);
+}
+
+void Editor::setFileName(QString name)
+{
+    if (name != fileName && !fileName.isEmpty())
+        spinParser->clearOverlay(fileName);
+    fileName = name;
+    setHighlights();
+}
+
+/* let autocomplete see what has been typed but not saved */
+void Editor::updateSpinOverlay()
+{
+    if (fileName.isEmpty() || !fileName.endsWith(".spin",Qt::CaseInsensitive))
+        return;
+
+    if (contentChanged() && parseDirty)
+        spinParser->setOverlay(fileName, toPlainText(), parseFirstLine, parseLastLines);
+    else if (!contentChanged())
+        spinParser->clearOverlay(fileName);
+    parseDirty = false;
+}
+
+/* widen the range of changed lines to the blocks of this change */
+void Editor::spinContentsChange(int position, int removed, int added)
+{
+    Q_UNUSED(removed);
+
+    QTextBlock last = document()->findBlock(position + added);
+    int first = document()->findBlock(position).blockNumber();
+    int end = last.isValid() ? last.blockNumber() : blockCount()-1;
+    int lastLines = blockCount()-1 - end;
+
+    if (parseDirty) {
+        parseFirstLine = qMin(parseFirstLine, first);
+        parseLastLines = qMin(parseLastLines, lastLines);
+    }
+    else {
+        parseFirstLine = first;
+        parseLastLines = lastLines;
+        parseDirty = true;
+    }
+}
+
+void Editor::closeEvent(QCloseEvent *e)
+{
+    // unsaved changes are dropped with the editor
+    parseTimer.stop();
+    if (!fileName.isEmpty())
+        spinParser->clearOverlay(fileName);
+    QPlainTextEdit::closeEvent(e);
 }
 
 int Editor::contentChanged()
@@ -227,9 +301,9 @@ void Editor::spinSuggest()
     QStringList toolTextList;
     if(text.length() > 2) {
         int added = 0;
-        QStringList list = spinParser.spinSymbols(fileName,"");
-        foreach(QString s, list) {
-            s = s.mid(s.indexOf("\t")+1); // skip type field
+        SpinParser::SymbolList list = spinParser->spinSymbols(fileName,"");
+        for(int n = 0; n < list.count(); n++) {
+            QString s = list.declaration(n);
             if(s.contains(text,Qt::CaseInsensitive)) {
                 QRegExp rx("([ \t]+)");
                 if(s.contains(rx)) // replace multiple space/tab with space
@@ -408,13 +482,81 @@ void Editor::mouseMoveEvent (QMouseEvent *e)
 void Editor::mousePressEvent (QMouseEvent *e)
 {
     if(ctrlPressed) {
-        qDebug() << "mousePressEvent ctrlPressed (not implemented yet)";
-        //static_cast<MAINWINDOW*>(mainwindow)->findDeclaration(e->pos());
         ctrlPressed = false;
+        if(findDeclaration(cursorForPosition(e->pos())))
+            return;
     }
     QPlainTextEdit::mousePressEvent(e);
 }
 
+/*
+ * get the symbol name at cur. obj.name, obj[n].name and obj#name give obj,
+ * a local DAT label name starts with a colon. returns false if there
+ * is no name at cur.
+ */
+bool Editor::symbolAt(QTextCursor cur, QString & name, QString & objname)
+{
+    if(!isSpin)
+        return false;
+
+    cur.select(QTextCursor::WordUnderCursor);
+    name = cur.selectedText().trimmed();
+    objname.clear();
+    if(name.isEmpty() || !(name.at(0).isLetter() || name.at(0) == '_'))
+        return false;
+
+    QString line = cur.block().text();
+    int start = cur.selectionStart() - cur.block().position();
+
+    if(start > 0 && (line.at(start-1) == '.' || line.at(start-1) == '#')) {
+        int end = start-1;
+        if(end > 0 && line.at(end-1) == ']' && line.lastIndexOf('[', end-1) >= 0)
+            end = line.lastIndexOf('[', end-1);
+        int begin = end;
+        while(begin > 0 && (line.at(begin-1).isLetterOrNumber() || line.at(begin-1) == '_'))
+            begin--;
+        objname = line.mid(begin, end-begin);
+    }
+    else if(start > 0 && line.at(start-1) == ':') {
+        name.prepend(":");
+    }
+    return true;
+}
+
+/* go to where the symbol at cur is declared, false if it isn't known */
+bool Editor::findDeclaration(QTextCursor cur)
+{
+    QString name;
+    QString objname;
+    if(!symbolAt(cur, name, objname))
+        return false;
+
+    SpinParser::SymbolList list = spinParser->spinDefinition(fileName, cur.blockNumber(), name, objname);
+    if(list.isEmpty())
+        return false;
+
+    static_cast<MAINWINDOW*>(mainwindow)->highlightFileLine(list.file(0), list.line(0));
+    return true;
+}
+
+/* hovering over a constant shows its value */
+bool Editor::viewportEvent(QEvent *e)
+{
+    if(e->type() == QEvent::ToolTip && isSpin) {
+        QHelpEvent *help = static_cast<QHelpEvent *>(e);
+        QString name;
+        QString objname;
+        if(symbolAt(cursorForPosition(help->pos()), name, objname)) {
+            QString value = spinParser->spinConstantValue(fileName, name, objname);
+            if(value.length() > 0) {
+                QToolTip::showText(help->globalPos(), name+" = "+value, this);
+                return true;
+            }
+        }
+    }
+    return QPlainTextEdit::viewportEvent(e);
+}
+
 void Editor::mouseDoubleClickEvent (QMouseEvent *e)
 {
     QPlainTextEdit::mouseDoubleClickEvent(e);
@@ -678,6 +820,8 @@ int Editor::addAutoItem(QString type, QString s)
     } else if(ch.compare("x") == 0) {
         icon.addFile(":/icons/block-dat.png");
         split = true;
+    } else if(ch.compare("a") == 0 || ch.compare("l") == 0 || ch.compare("r") == 0) {
+        icon.addFile(":/icons/block-var.png");
     }
 
     QStringList lst;
@@ -794,7 +938,7 @@ int Editor::spinAutoComplete()
      */
     if(text.length() > 0) {
         qDebug() << "keyPressEvent object dot pressed" << text;
-        QStringList list = spinParser.spinSymbols(fileName,text);
+        SpinParser::SymbolList list = spinParser->spinSymbols(fileName,text);
         if(list.count() == 0)
             return 0;
         cbAuto->clear();
@@ -837,21 +981,19 @@ int Editor::spinAutoComplete()
      */
     else {
         //qDebug() << "keyPressEvent local dot pressed";
-        QStringList list = spinParser.spinSymbols(fileName,"");
-        if(list.count() == 0)
+        // objects are always on top
+        SpinParser::SymbolList list = spinParser->spinSymbols(fileName,"");
+        SpinParser::SymbolList locals = spinParser->spinLocals(fileName, textCursor().blockNumber());
+        if(list.count() == 0 && locals.count() == 0)
             return 0;
         cbAuto->clear();
         cbAuto->addItem(".");
-        if(list.count() > 0) {
+        if(list.count() > 0 || locals.count() > 0) {
             int width = 0;
-            // always put objects on top
-            for(int j = 0; j < list.count(); j++) {
-                QString s = list[j];
-                QString type = s;
-                if(type.at(0) == 'o') {
-                    list.removeAt(j);
-                    list.insert(0,s);
-                }
+            // parameters, results and locals of the method the cursor is in
+            for(int j = 0; j < locals.count(); j++) {
+                int w = addAutoItem(locals[j], spinPrune(locals[j]));
+                if(w > width) width = w;
             }
             // add all elements
             for(int j = 0; j < list.count(); j++) {
@@ -875,6 +1017,18 @@ int Editor::spinAutoComplete()
     return 0;
 }
 
+/* show the value of each constant in the autocomplete list as its tool tip */
+void Editor::setAutoValues(QString objname)
+{
+    // item 0 is the auto-start key
+    for(int n = 1; n < cbAuto->count(); n++) {
+        QString name = cbAuto->itemText(n);
+        QString value = spinParser->spinConstantValue(fileName, name, objname);
+        if(value.length() > 0)
+            cbAuto->setItemData(n, name+" = "+value, Qt::ToolTipRole);
+    }
+}
+
 int  Editor::spinAutoCompleteCON()
 {
 #ifdef SPIN_AUTOCON
@@ -883,7 +1037,7 @@ int  Editor::spinAutoCompleteCON()
     if(text.length() > 0) {
         connect(cbAuto, SIGNAL(activated(int)), this, SLOT(cbAutoSelected0insert(int)));
         qDebug() << "keyPressEvent # pressed" << text;
-        QStringList list = spinParser.spinConstants(fileName,text);
+        QStringList list = spinParser->spinConstants(fileName,text).toStringList();
         if(list.count() == 0)
             return 0;
         cbAuto->clear();
@@ -899,6 +1053,7 @@ int  Editor::spinAutoCompleteCON()
                 int w = addAutoItem(type, s);
                 if(w > width) width = w;
             }
+            setAutoValues(text);
             spinAutoShow(width);
         }
         return 1;
@@ -909,7 +1064,7 @@ int  Editor::spinAutoCompleteCON()
     else {
         connect(cbAuto, SIGNAL(activated(int)), this, SLOT(cbAutoSelected(int)));
         qDebug() << "keyPressEvent local # pressed";
-        QStringList list = spinParser.spinConstants(fileName,"");
+        QStringList list = spinParser->spinConstants(fileName,"").toStringList();
         if(list.count() == 0)
             return 0;
         cbAuto->clear();
@@ -924,6 +1079,7 @@ int  Editor::spinAutoCompleteCON()
                 int w = addAutoItem(type, s);
                 if(w > width) width = w;
             }
+            setAutoValues("");
             spinAutoShow(width);
         }
         return 1;
@@ -1162,8 +1318,10 @@ void Editor::updateLineNumberAreaWidth(int /* newBlockCount */)
 
 void Editor::updateLineNumberArea(const QRect &rect, int dy)
 {
-    if (dy)
+    if (dy) {
         lineNumberArea->scroll(0, dy);
+        updateVisibleBlocks();
+    }
     else
         lineNumberArea->update(0, rect.y(), lineNumberArea->width(), rect.height());
 
@@ -1180,6 +1338,23 @@ void Editor::resizeEvent(QResizeEvent *e)
 
     QRect cr = contentsRect();
     lineNumberArea->setGeometry(QRect(cr.left()-2, cr.top()-3, lineNumberAreaWidth(), cr.height()+3));
+
+    updateVisibleBlocks();
+}
+
+/*
+ * tell the highlighter which blocks are on screen. only scrolling,
+ * resizing or a change of the document layout can move them, so it
+ * isn't done on every repaint.
+ */
+void Editor::updateVisibleBlocks()
+{
+    if (!highlighter)
+        return;
+
+    int first = firstVisibleBlock().blockNumber();
+    int last = cursorForPosition(QPoint(0, viewport()->height()-1)).blockNumber();
+    highlighter->setVisibleBlocks(first, last);
 }
 
 void Editor::updateColors()
@@ -1196,7 +1371,7 @@ void Editor::updateColors()
         i.value().color = i.value().color.lighter(105+((int)10.0*colordiff ));
     }
 
-    setHighlights();
+    highlighter->updateColors();
 
     QPalette p = this->palette();
     p.setColor(QPalette::Text, colors[ColorScheme::SyntaxText].color);
@@ -1232,42 +1407,34 @@ void Editor::updateBackgroundColors()
     {
         ColorScheme::Color newColor = ColorScheme::Invalid;
 
-        if ( currBlock.text().contains('{') )
+        QString text = currBlock.text();
+
+        if ( text.contains('{') )
         {
             nInComment++;
         }
-        if ( currBlock.text().contains('}') && nInComment > 0 )
+        if ( text.contains('}') && nInComment > 0 )
         {
             nInComment--;
         }
 
-        if ( currBlock.text().startsWith("CON", Qt::CaseInsensitive) )
-        {
-            newColor = ColorScheme::ConBG;
-        }
-        else if ( currBlock.text().startsWith("VAR", Qt::CaseInsensitive) )
-        {
-            newColor = ColorScheme::VarBG;
-        }
-        else if ( currBlock.text().startsWith("OBJ", Qt::CaseInsensitive) )
-        {
-            newColor = ColorScheme::ObjBG;
-        }
-        else if ( currBlock.text().startsWith("PUB", Qt::CaseInsensitive) )
-        {
-            newColor = ColorScheme::PubBG;
-        }
-        else if ( currBlock.text().startsWith("PRI", Qt::CaseInsensitive) )
-        {
-            newColor = ColorScheme::PriBG;
-        }
-        else if ( currBlock.text().startsWith("DAT", Qt::CaseInsensitive) )
+        // the whole word at the start of the line must be a section keyword
+        int length = 0;
+        while (length < text.length() && (text[length].isLetterOrNumber() || text[length] == '_'))
+            length++;
+
+        switch (SpinKeyword::find(text.constData(), length))
         {
-            newColor = ColorScheme::DatBG;
+            case SpinKeyword::KW_CON: newColor = ColorScheme::ConBG; break;
+            case SpinKeyword::KW_VAR: newColor = ColorScheme::VarBG; break;
+            case SpinKeyword::KW_OBJ: newColor = ColorScheme::ObjBG; break;
+            case SpinKeyword::KW_PUB: newColor = ColorScheme::PubBG; break;
+            case SpinKeyword::KW_PRI: newColor = ColorScheme::PriBG; break;
+            case SpinKeyword::KW_DAT: newColor = ColorScheme::DatBG; break;
+            default: break;
         }
 
-        if (nInComment > 0
-        || (currBlock.text().length() > 3 && QRegExp("\\w").exactMatch(QString(currBlock.text()[3]))))
+        if (nInComment > 0)
         {
             newColor = ColorScheme::Invalid;
         }
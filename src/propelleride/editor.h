@@ -8,6 +8,7 @@
 #include <QResizeEvent>
 #include <QPaintEvent>
 #include <QTextCursor>
+#include <QTimer>
 
 #include "Highlighter.h"
 #include "SpinParser.h"
@@ -29,10 +30,15 @@ public:
 
     void clearCtrlPressed();
 
-    SpinParser spinParser;
     void saveContent();
     int contentChanged();
 
+    /* the file the editor shows, empty for a new file */
+    void setFileName(QString name);
+
+    /* the name at cur, and obj if it is used as obj.name */
+    bool symbolAt(QTextCursor cur, QString & name, QString & objname);
+
 public slots:
     bool getUndo();
     bool getRedo();
@@ -53,6 +59,7 @@ private:
     QString spinPrune(QString s);
     int addAutoItem(QString type, QString s);
     void spinAutoShow(int width);
+    void setAutoValues(QString objname);
     int  spinAutoComplete();
     int  spinAutoCompleteCON();
     int  contextHelp();
@@ -64,6 +71,7 @@ private:
     void selectSpinSuggestion(int key);
     void useSpinSuggestion(int key);
     QPoint keyPopPoint(QTextCursor cursor);
+    bool findDeclaration(QTextCursor cur);
 
     ColorScheme * currentTheme;
     QMap<ColorScheme::Color, ColorScheme::color> colors;
@@ -77,6 +85,8 @@ protected:
     void mousePressEvent(QMouseEvent* e);
     void mouseMoveEvent(QMouseEvent* e);
     void mouseDoubleClickEvent (QMouseEvent *e);
+    void closeEvent(QCloseEvent *e);
+    bool viewportEvent(QEvent *e);
 
 private:
     QWidget *mainwindow;
@@ -91,6 +101,15 @@ private:
     bool expectAutoComplete;
 
     Preferences *propDialog;
+    SpinParser  *spinParser;
+
+    /* gives unsaved changes to spinParser once typing pauses */
+    QTimer      parseTimer;
+
+    /* lines changed since spinParser last got the text, see SpinParser::setOverlay */
+    bool        parseDirty;
+    int         parseFirstLine;
+    int         parseLastLines;
 
 private slots:
     void cbAutoSelected(int index);
@@ -98,6 +117,8 @@ private slots:
     void updateColors();
     void updateFonts();
     void tabSpacesChanged();
+    void updateSpinOverlay();
+    void spinContentsChange(int position, int removed, int added);
 
 /* lineNumberArea support below this line: see Nokia Copyright below */
 public:
@@ -111,6 +132,7 @@ private slots:
     void updateLineNumberAreaWidth(int newBlockCount);
     void updateBackgroundColors();
     void updateLineNumberArea(const QRect &, int);
+    void updateVisibleBlocks();
 
 private:
     QWidget *lineNumberArea;
@@ -7,6 +7,7 @@
 #include <QMenu> 
 #include <QSerialPortInfo>
 #include <QProcess>
+#include <QTextStream>
 
 MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent), statusMutex(QMutex::Recursive), statusDone(true)
 {
@@ -15,8 +16,12 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent), statusMutex(QMute
     propDialog = new Preferences(this);
     connect(propDialog,SIGNAL(accepted()),this,SLOT(preferencesAccepted()));
 
+    connect(&spinParser,SIGNAL(projectScanned(QString)),this,SLOT(spinProjectScanned(QString)));
+    connect(&spinParser,SIGNAL(sendMessage(const QString &)),this,SLOT(showMessage(const QString &)));
+
     projectModel = NULL;
     referenceModel = NULL;
+    usageModel = NULL;
 
     connect(&builder,SIGNAL(compilerErrorInfo(QString,int)), this, SLOT(highlightFileLine(QString,int)));
 
@@ -66,6 +71,8 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent), statusMutex(QMute
     connect(ui.action_Find,        SIGNAL(triggered()), finder, SLOT(showFinder()));
     connect(ui.actionFind_Next,    SIGNAL(triggered()), finder, SLOT(findNext()));
     connect(ui.actionFind_Previous,SIGNAL(triggered()), finder, SLOT(findPrevious()));
+    connect(ui.actionFind_Usages,  SIGNAL(triggered()), this, SLOT(findUsages()));
+    connect(ui.actionGo_to_Symbol, SIGNAL(triggered()), symbolFinder, SLOT(showFinder()));
 
     connect(ui.actionPreferences,  SIGNAL(triggered()), this, SLOT(preferences()));
 
@@ -722,6 +729,63 @@ void MainWindow::referenceTreeClicked(QModelIndex index)
     }
 }
 
+void MainWindow::usageTreeClicked(QModelIndex index)
+{
+    if(index.row() < 0 || index.row() >= usages.count())
+        return;
+
+    const SpinParser::Reference & r = usages.at(index.row());
+    highlightFileLine(r.file, r.line);
+}
+
+/* list every use of the symbol at the cursor */
+void MainWindow::findUsages()
+{
+    int index = editorTabs->currentIndex();
+    if(index < 0)
+        return;
+
+    Editor *editor = editorTabs->getEditor(index);
+    QTextCursor cur = editor->textCursor();
+    QString name;
+    QString objname;
+    if(!editor->symbolAt(cur, name, objname))
+        return;
+
+    usages = spinParser.spinReferences(editorTabs->tabToolTip(index), cur.blockNumber(), name, objname);
+
+    // show each line as it is in its editor, or on disk
+    QHash<QString, QStringList> texts;
+    TreeModel *model = new TreeModel(name, this);
+    foreach (const SpinParser::Reference & r, usages)
+    {
+        if(!texts.contains(r.file)) {
+            QString text;
+            for(int n = 0; n < editorTabs->count(); n++) {
+                if(editorTabs->tabToolTip(n) == r.file)
+                    text = editorTabs->getEditor(n)->toPlainText();
+            }
+            if(text.isEmpty()) {
+                QFile file(r.file);
+                if(file.open(QFile::ReadOnly | QFile::Text))
+                    text = QTextStream(&file).readAll();
+            }
+            texts.insert(r.file, text.split(QRegExp("\\r\\n|\\n|\\r")));
+        }
+        model->addRootItem(QString("%1:%2:%3: %4")
+                .arg(QFileInfo(r.file).fileName())
+                .arg(r.line+1).arg(r.column+1)
+                .arg(texts.value(r.file).value(r.line).trimmed()), r.file);
+    }
+
+    usageTree->setModel(model);
+    delete usageModel;
+    usageModel = model;
+
+    leftSplit->show();
+    showMessage(tr("%1 usages of %2").arg(usages.count()).arg(name));
+}
+
 void MainWindow::zipFiles()
 {
     int n = this->editorTabs->currentIndex();
@@ -731,9 +795,7 @@ void MainWindow::zipFiles()
         return;
 
     QString spinLibPath     = QSettings().value("Library").toString();
-    QStringList fileTree    = editorTabs->getEditor(
-            editorTabs->currentIndex()
-            )->spinParser.spinFileTree(fileName, spinLibPath);
+    QStringList fileTree    = spinParser.spinFileTree(fileName, spinLibPath);
     if(fileTree.count() > 0)
     {
         zipper.makeZip(fileName, fileTree, spinLibPath);
@@ -763,13 +825,33 @@ void MainWindow::updateProjectTree(QString fileName)
 
 void MainWindow::updateSpinProjectTree(QString fileName)
 {
-    /* for spin we always parse the program and stuff the file list */
-    QStringList flist = editorTabs->getEditor(editorTabs->currentIndex())->spinParser.spinFileTree(fileName, QSettings().value("Library").toString());
+    /* for spin we always parse the program in the background,
+     * the file list is stuffed by spinProjectScanned when it's done */
+    spinParser.scanFileTree(fileName, QSettings().value("Library").toString());
+}
+
+void MainWindow::spinProjectScanned(QString fileName)
+{
+    int index = editorTabs->currentIndex();
 
-    foreach (QString s, flist)
+    // a newer project has been set in the mean time
+    if (fileName != projectFile || index < 0)
+        return;
+
+    QString s = QFileInfo(fileName).fileName();
+    TreeModel * model = new TreeModel(s, this);
+
+    foreach (QString f, spinParser.spinFileList())
     {
-        projectModel->addRootItem(s);
+        model->addRootItem(f);
     }
+
+    projectTree->setModel(model);
+    delete projectModel;
+    projectModel = model;
+
+    if (referenceModel != NULL)
+        updateReferenceTree(fileName, editorTabs->getEditor(index)->toPlainText());
 }
 
 void MainWindow::updateReferenceTree(QString fileName, QString text)
@@ -800,18 +882,8 @@ void MainWindow::updateSpinReferenceTree(QString fileName, QString includes, QSt
 {
     QString path = QFileInfo(fileName).path();
 
-    QStringList mlist = editorTabs->getEditor(
-            editorTabs->currentIndex())->spinParser.spinMethods(fileName,  objname);
-
-    // move objects to end of the list
-    for (int n = mlist.count()-1; n > -1; n--)
-    {
-        if(mlist[n].at(0) == 'o')
-        {
-            mlist.insert(mlist.count(),mlist[n]);
-            mlist.removeAt(n);
-        }
-    }
+    // objects are at the end of the list
+    SpinParser::SymbolList mlist = spinParser.spinMethods(fileName,  objname);
 
     // display all
     for (int n = 0; n < mlist.count(); n ++)
@@ -950,16 +1022,28 @@ void MainWindow::setupProjectTools(QSplitter *vsplit)
 
     leftSplit->addWidget(referenceTree);
 
+    // find usages results
+    usageTree = new ReferenceTree(tr("Usages"), ColorScheme::DatBG);
+    connect(usageTree,SIGNAL(clicked(QModelIndex)),this,SLOT(usageTreeClicked(QModelIndex)));
+
+    connect(propDialog,SIGNAL(updateColors()),usageTree,SLOT(updateColors()));
+    connect(propDialog,SIGNAL(updateFonts()),usageTree,SLOT(updateFonts()));
+
+    leftSplit->addWidget(usageTree);
+
 
     projectTree->updateColors();
     referenceTree->updateColors();
+    usageTree->updateColors();
 
     projectTree->updateFonts();
     referenceTree->updateFonts();
+    usageTree->updateFonts();
 
 
     leftSplit->setStretchFactor(0,1);
     leftSplit->setStretchFactor(1,2);
+    leftSplit->setStretchFactor(2,1);
 
     findSplit = new QSplitter(this);
     findSplit->setOrientation(Qt::Vertical);
@@ -976,6 +1060,9 @@ void MainWindow::setupProjectTools(QSplitter *vsplit)
     findSplit->setContentsMargins(0,0,handlewidth,0);
 
     finder = new Finder(editorTabs, this);
+
+    symbolFinder = new SymbolFinder(&spinParser, this);
+    connect(symbolFinder,SIGNAL(symbolSelected(QString,int)),this,SLOT(highlightFileLine(QString,int)));
     findSplit->addWidget(finder);//newFindFrame(findSplit));
     QSplitterHandle *hndl = findSplit->handle(1);
     hndl->setEnabled(false);
@@ -1001,6 +1088,9 @@ bool MainWindow::eventFilter(QObject *target, QEvent *event)
             switch (e->key())
             {
             case (Qt::Key_T):
+                // Ctrl+Shift+T is Go to Symbol
+                if (e->modifiers() & Qt::ShiftModifier)
+                    break;
                 editorTabs->newFile();
                 return true;
             case (Qt::Key_W):
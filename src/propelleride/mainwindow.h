@@ -20,6 +20,7 @@
 #include "FileManager.h"
 #include "BuildManager.h"
 #include "Finder.h"
+#include "SymbolFinder.h"
 
 class MainWindow : public QMainWindow
 {
@@ -32,6 +33,7 @@ public:
     MainWindow(QWidget *parent = 0);
 
     Preferences  *propDialog;
+    SpinParser   spinParser;    /* the project symbols all editors share */
     QSplitter   *leftSplit;
     QSplitter   *findSplit;
 
@@ -58,6 +60,8 @@ public slots:
     void findMultilineComment(QTextCursor cur);
     void projectTreeClicked(QModelIndex index);
     void referenceTreeClicked(QModelIndex index);
+    void usageTreeClicked(QModelIndex index);
+    void findUsages();
     void setCurrentPort(int index);
     void spawnTerminal();
     void setProject();
@@ -80,6 +84,8 @@ public slots:
 
     void highlightFileLine(QString file, int line);
 
+    void spinProjectScanned(QString fileName);
+
 private:
     void loadSession();
     void saveSession();
@@ -120,6 +126,7 @@ private:
     QFrame      *findFrame;
 
     Finder * finder;
+    SymbolFinder * symbolFinder;
     FileManager     *editorTabs;
     BuildManager    builder;
 
@@ -128,6 +135,9 @@ private:
     ReferenceTree   *referenceTree;
     TreeModel       *projectModel;
     TreeModel       *referenceModel;
+    ReferenceTree   *usageTree;
+    TreeModel       *usageModel;
+    QList<SpinParser::Reference> usages;    /* the rows of usageModel */
 
     QComboBox   *cbPort;
 
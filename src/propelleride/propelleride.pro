@@ -29,12 +29,20 @@ SOURCES += \
     editor.cpp \
     status.cpp \
     SpinParser.cpp \
+    SpinExpression.cpp \
+    SpinFileResolver.cpp \
+    SpinKeyword.cpp \
+    SpinSymbolTable.cpp \
+    SpinTokenizer.cpp \
+    SyntaxLexer.cpp \
     ColorScheme.cpp \
     ColorChooser.cpp \
     FileManager.cpp \
     BuildManager.cpp \
     Language.cpp \
+    LanguageRegistry.cpp \
     Finder.cpp \
+    SymbolFinder.cpp \
 
 HEADERS  += \
     mainwindow.h \
@@ -48,6 +56,12 @@ HEADERS  += \
     ReferenceTree.h \
     editor.h \
     SpinParser.h \
+    SpinExpression.h \
+    SpinFileResolver.h \
+    SpinKeyword.h \
+    SpinSymbolTable.h \
+    SpinTokenizer.h \
+    SyntaxLexer.h \
     status.h \
     ColorChooser.h \
     ColorScheme.h \
@@ -55,7 +69,9 @@ HEADERS  += \
     FileManager.h \
     BuildManager.h \
     Language.h \
+    LanguageRegistry.h \
     Finder.h \
+    SymbolFinder.h \
 
 OTHER_FILES +=
 
@@ -0,0 +1,546 @@
+#include <QtTest>
+#include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include <QTextStream>
+
+#include "Language.h"
+#include "SpinParser.h"
+#include "SyntaxLexer.h"
+
+/*
+ * Benchmarks for the SpinParser hot paths.
+ *
+ * Each row generates a synthetic project: depth layers of files, every
+ * file but the last layer instantiating fanout objects of the next one.
+ * A file has about lines lines, con and dat give the share of them
+ * spent on constants and data.
+ *
+ * The environment adds rows or data sets:
+ *   SPINBENCH_FILES, SPINBENCH_FANOUT, SPINBENCH_DEPTH,
+ *   SPINBENCH_LINES, SPINBENCH_CON, SPINBENCH_DAT   a custom synthetic row
+ *   SPINBENCH_PROJECT                              a real top object file
+ *   SPINBENCH_LIBRARY                              a library to parse file by file
+ *   SPINBENCH_HIGHLIGHT                            a file to color line by line
+ *
+ * Peak memory is the process high water mark where the system reports
+ * it, so it only grows from one benchmark to the next.
+ */
+class SpinParserBenchmark : public QObject
+{
+    Q_OBJECT
+
+private:
+    typedef struct {
+        int files;
+        int fanout;
+        int depth;
+        int lines;
+        double con;
+        double dat;
+    } Shape;
+
+    QTemporaryDir dir;
+    QHash<QString, QString> projects;
+
+    QString project(const QString & name, const Shape & shape);
+    void writeFile(const QString & fileName, int index, const QStringList & children, const Shape & shape);
+    void addShapes();
+    QString fetchProject();
+    static QString libraryPath();
+    static qint64 peakMemory();
+    static void reportMemory(const char * what);
+
+private slots:
+    void initTestCase();
+
+    void spinFileTreeCold_data();
+    void spinFileTreeCold();
+    void spinFileTreeWarm_data();
+    void spinFileTreeWarm();
+    void spinSymbols_data();
+    void spinSymbols();
+    void spinMethods_data();
+    void spinMethods();
+    void spinConstants_data();
+    void spinConstants();
+    void spinReferences_data();
+    void spinReferences();
+    void spinSearch_data();
+    void spinSearch();
+
+    void parseLibrary();
+
+    void syntaxLexer_data();
+    void syntaxLexer();
+};
+
+static int envInt(const char * name, int fallback)
+{
+    bool ok;
+    int value = qgetenv(name).toInt(&ok);
+    return ok ? value : fallback;
+}
+
+static double envDouble(const char * name, double fallback)
+{
+    bool ok;
+    double value = qgetenv(name).toDouble(&ok);
+    return ok ? value : fallback;
+}
+
+qint64 SpinParserBenchmark::peakMemory()
+{
+    QFile status("/proc/self/status");
+    if (!status.open(QFile::ReadOnly))
+        return -1;
+
+    QTextStream in(&status);
+    for (QString line = in.readLine(); !line.isNull(); line = in.readLine())
+    {
+        if (line.startsWith("VmHWM:"))
+            return line.mid(6).trimmed().split(' ').first().toLongLong() * 1024;
+    }
+    return -1;
+}
+
+void SpinParserBenchmark::reportMemory(const char * what)
+{
+    qint64 peak = peakMemory();
+    if (peak >= 0)
+        qDebug() << what << "peak memory" << peak / 1024 << "KiB";
+}
+
+void SpinParserBenchmark::initTestCase()
+{
+    // keep away from the IDE settings and symbol index
+    QCoreApplication::setOrganizationName("Parallax");
+    QCoreApplication::setApplicationName("spinbench");
+
+    QVERIFY(dir.isValid());
+}
+
+void SpinParserBenchmark::writeFile(const QString & fileName, int index,
+        const QStringList & children, const Shape & shape)
+{
+    QFile file(fileName);
+    QVERIFY(file.open(QFile::WriteOnly | QFile::Truncate));
+    QTextStream out(&file);
+
+    int cons = shape.lines * shape.con;
+    int dats = shape.lines * shape.dat;
+    int code = qMax(shape.lines - cons - dats - children.count() - 8, 4);
+
+    out << "{{ generated object " << index << " }}\n";
+    out << "CON\n";
+    out << "  _clkmode = xtal1 + pll16x\n";
+    for (int n = 0; n < cons; n++)
+    {
+        if (n % 8 == 7)
+            out << "  #" << n << ", ENUM_" << n << "_A, ENUM_" << n << "_B\n";
+        else
+            out << "  CONST_" << n << " = " << n << " * 4   ' constant " << n << "\n";
+    }
+
+    out << "OBJ\n";
+    for (int n = 0; n < children.count(); n++)
+        out << "  child" << n << " : \"" << children[n] << "\"\n";
+
+    out << "VAR\n";
+    out << "  long value_" << index << "[4], count_" << index << "\n";
+
+    // methods of about 8 lines each
+    for (int n = 0; n < code; n += 8)
+    {
+        out << (n % 16 ? "PRI" : "PUB") << " method_" << n << "(a, b) : r | i\n";
+        out << "  { block comment with a ' quote }\n";
+        out << "  repeat i from 0 to a\n";
+        out << "    r += b * i   ' line comment\n";
+        out << "    if r > CONST_0\n";
+        out << "      quit\n";
+        out << "  str := string(\"text with ' and { inside\")\n";
+        out << "  return r\n";
+    }
+
+    out << "DAT\n";
+    for (int n = 0; n < dats; n++)
+        out << "label_" << n << "  long  " << n << ", $FF, %1010\n";
+}
+
+/* generate the files of a shape once, return its top file */
+QString SpinParserBenchmark::project(const QString & name, const Shape & shape)
+{
+    if (projects.contains(name))
+        return projects.value(name);
+
+    QString path = dir.path() + "/" + name;
+    QDir().mkpath(path);
+
+    // files per layer below the top file
+    int depth = qMax(shape.depth, 1);
+    int layer = depth > 1 ? qMax((shape.files - 1) / (depth - 1), 1) : 0;
+
+    QStringList names;
+    QList<int> layers;
+    names << "top.spin";
+    layers << 0;
+    for (int d = 1; d < depth; d++)
+    {
+        for (int n = 0; n < layer; n++)
+        {
+            names << QString("obj_%1_%2.spin").arg(d).arg(n);
+            layers << d;
+        }
+    }
+
+    int next = 0;
+    for (int n = 0; n < names.count(); n++)
+    {
+        QStringList children;
+        if (layers[n] < depth - 1)
+        {
+            int first = 1 + layers[n] * layer;
+            for (int k = 0; k < shape.fanout; k++)
+                children << names[first + (next++ % layer)];
+        }
+        writeFile(path + "/" + names[n], n, children, shape);
+    }
+
+    QString top = path + "/top.spin";
+    projects.insert(name, top);
+    return top;
+}
+
+void SpinParserBenchmark::addShapes()
+{
+    QTest::addColumn<QString>("name");
+    QTest::addColumn<int>("files");
+    QTest::addColumn<int>("fanout");
+    QTest::addColumn<int>("depth");
+    QTest::addColumn<int>("lines");
+    QTest::addColumn<double>("con");
+    QTest::addColumn<double>("dat");
+
+    QTest::newRow("small")  << "small"  << 10   << 3  << 3 << 200  << 0.1 << 0.1;
+    QTest::newRow("medium") << "medium" << 100  << 4  << 4 << 500  << 0.1 << 0.1;
+    QTest::newRow("large")  << "large"  << 600  << 6  << 5 << 1000 << 0.2 << 0.2;
+    QTest::newRow("wide")   << "wide"   << 200  << 50 << 2 << 300  << 0.1 << 0.1;
+
+    if (qEnvironmentVariableIsSet("SPINBENCH_FILES"))
+    {
+        QTest::newRow("custom") << "custom"
+            << envInt("SPINBENCH_FILES", 100)
+            << envInt("SPINBENCH_FANOUT", 4)
+            << envInt("SPINBENCH_DEPTH", 4)
+            << envInt("SPINBENCH_LINES", 500)
+            << envDouble("SPINBENCH_CON", 0.1)
+            << envDouble("SPINBENCH_DAT", 0.1);
+    }
+
+    if (qEnvironmentVariableIsSet("SPINBENCH_PROJECT"))
+    {
+        QTest::newRow("project") << "project" << 0 << 0 << 0 << 0 << 0.0 << 0.0;
+    }
+}
+
+/* generate or look up the project of the current row */
+QString SpinParserBenchmark::fetchProject()
+{
+    QFETCH(QString, name);
+    QFETCH(int, files);
+    QFETCH(int, fanout);
+    QFETCH(int, depth);
+    QFETCH(int, lines);
+    QFETCH(double, con);
+    QFETCH(double, dat);
+
+    if (name == "project")
+        return QString::fromLocal8Bit(qgetenv("SPINBENCH_PROJECT"));
+
+    Shape shape = { files, fanout, depth, lines, con, dat };
+    return project(name, shape);
+}
+
+QString SpinParserBenchmark::libraryPath()
+{
+    QString library = QString::fromLocal8Bit(qgetenv("SPINBENCH_LIBRARY"));
+    if (!library.isEmpty() && !library.endsWith("/"))
+        library += "/";
+    return library;
+}
+
+void SpinParserBenchmark::spinFileTreeCold_data()
+{
+    addShapes();
+}
+
+/* a new parser has nothing cached */
+void SpinParserBenchmark::spinFileTreeCold()
+{
+    QString top = fetchProject();
+    QString library = libraryPath();
+
+    QBENCHMARK {
+        SpinParser parser;
+        QVERIFY(!parser.spinFileTree(top, library).isEmpty());
+    }
+    reportMemory("spinFileTree cold");
+}
+
+void SpinParserBenchmark::spinFileTreeWarm_data()
+{
+    addShapes();
+}
+
+/* the parser has all files cached, this is linking only */
+void SpinParserBenchmark::spinFileTreeWarm()
+{
+    QString top = fetchProject();
+    QString library = libraryPath();
+
+    SpinParser parser;
+    parser.spinFileTree(top, library);
+
+    QBENCHMARK {
+        parser.spinFileTree(top, library);
+    }
+    reportMemory("spinFileTree warm");
+}
+
+void SpinParserBenchmark::spinSymbols_data()
+{
+    addShapes();
+}
+
+void SpinParserBenchmark::spinSymbols()
+{
+    QString top = fetchProject();
+    QString library = libraryPath();
+
+    SpinParser parser;
+    parser.spinFileTree(top, library);
+
+    QBENCHMARK {
+        parser.spinSymbols(top, "");
+        parser.spinSymbols("", "child0");
+    }
+    reportMemory("spinSymbols");
+}
+
+void SpinParserBenchmark::spinMethods_data()
+{
+    addShapes();
+}
+
+void SpinParserBenchmark::spinMethods()
+{
+    QString top = fetchProject();
+    QString library = libraryPath();
+
+    SpinParser parser;
+    parser.spinFileTree(top, library);
+
+    QBENCHMARK {
+        parser.spinMethods(top, "");
+        parser.spinMethods("", "child0");
+    }
+    reportMemory("spinMethods");
+}
+
+void SpinParserBenchmark::spinConstants_data()
+{
+    addShapes();
+}
+
+void SpinParserBenchmark::spinConstants()
+{
+    QString top = fetchProject();
+    QString library = libraryPath();
+
+    SpinParser parser;
+    parser.spinFileTree(top, library);
+
+    QBENCHMARK {
+        parser.spinConstants(top, "");
+        parser.spinConstants("", "child0");
+    }
+    reportMemory("spinConstants");
+}
+
+void SpinParserBenchmark::spinReferences_data()
+{
+    addShapes();
+}
+
+/* every method of a file uses CONST_0 */
+void SpinParserBenchmark::spinReferences()
+{
+    QString top = fetchProject();
+    QString library = libraryPath();
+
+    SpinParser parser;
+    parser.spinFileTree(top, library);
+
+    QBENCHMARK {
+        parser.spinReferences(top, 0, "CONST_0", "");
+    }
+    reportMemory("spinReferences");
+}
+
+void SpinParserBenchmark::spinSearch_data()
+{
+    addShapes();
+}
+
+/* a word start pattern and a scattered one */
+void SpinParserBenchmark::spinSearch()
+{
+    QString top = fetchProject();
+    QString library = libraryPath();
+
+    SpinParser parser;
+    parser.spinFileTree(top, library);
+
+    QBENCHMARK {
+        parser.spinSearch("meth8", 100);
+        parser.spinSearch("cst1", 100);
+    }
+    reportMemory("spinSearch");
+}
+
+/*
+ * parse every file of a library as a top object and report lines per
+ * second. objects are shared, so each file is only parsed once.
+ */
+void SpinParserBenchmark::parseLibrary()
+{
+    QString library = libraryPath();
+    if (library.isEmpty())
+        QSKIP("SPINBENCH_LIBRARY is not set");
+
+    QStringList files;
+    qint64 lines = 0;
+
+    QDirIterator it(library, QStringList() << "*.spin", QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext())
+    {
+        QFile file(it.next());
+        if (!file.open(QFile::ReadOnly))
+            continue;
+        lines += file.readAll().count('\n');
+        files << file.fileName();
+    }
+    if (files.isEmpty())
+        QSKIP("no spin files in SPINBENCH_LIBRARY");
+
+    QElapsedTimer timer;
+    timer.start();
+
+    SpinParser parser;
+    foreach (QString file, files)
+        parser.spinFileTree(file, library);
+
+    qint64 elapsed = qMax(timer.elapsed(), (qint64) 1);
+    qDebug() << files.count() << "files," << lines << "lines,"
+             << lines * 1000 / elapsed << "lines/second";
+    reportMemory("parseLibrary");
+}
+
+void SpinParserBenchmark::syntaxLexer_data()
+{
+    QTest::addColumn<QString>("language");
+    QTest::addColumn<QString>("file");
+    QTest::newRow("spin") << "spin.json" << "";
+    QTest::newRow("c") << "c.json" << "";
+
+    if (qEnvironmentVariableIsSet("SPINBENCH_HIGHLIGHT"))
+    {
+        QString file = QString::fromLocal8Bit(qgetenv("SPINBENCH_HIGHLIGHT"));
+        QString suffix = QFileInfo(file).suffix().toLower();
+        QTest::newRow("file") << (suffix == "c" || suffix == "h" ? "c.json" : "spin.json") << file;
+    }
+}
+
+/*
+ * color a 20000 line file block by block the way Highlighter does,
+ * carrying the state from one line to the next.
+ */
+void SpinParserBenchmark::syntaxLexer()
+{
+    QFETCH(QString, language);
+    QFETCH(QString, file);
+
+    QStringList lines;
+    if (file.isEmpty())
+    {
+        QStringList code;
+        if (language == "c.json")
+        {
+            code << "#include <propeller.h>"
+                 << "/* a comment"
+                 << "   over two lines */"
+                 << "static volatile int count = 0x1F;   // counter"
+                 << "int start(int pin, char *buffer)"
+                 << "{"
+                 << "    for (int i = 0; i < sizeof(buffer); i++)"
+                 << "        if (INA & (1 << pin) && !count)"
+                 << "            printf(\"x \\\"%d\\\"\\n\", lookup(i, 'a'));"
+                 << "    return cognew(entry, stack) + 1;"
+                 << "}";
+        }
+        else
+        {
+            code << "CON"
+                 << "    _clkmode = xtal1 + pll16x   ' 80 MHz"
+                 << "    MASK = %1010_0101 | $FF << 8"
+                 << "{ a comment"
+                 << "  over two lines }"
+                 << "PUB start(pin, count) : ok | i, buffer[16]"
+                 << "    repeat i from 0 to count - 1"
+                 << "        if ina[pin] == 1 and not ok"
+                 << "            ok := serial.tx(\"x\") + lookup(i: 1, 2, 3)"
+                 << "    return cognew(@entry, @stack) + 1"
+                 << "DAT"
+                 << "entry   mov     t1, par"
+                 << ":loop   rdlong  t2, t1 wz"
+                 << "        if_nz   djnz t2, #:loop"
+                 << "font    long    $0000_0000, $1818_1818, %%0123, 1_000"
+                 << "{{ doc }}";
+        }
+        for (int n = 0; lines.count() < 20000; n++)
+            lines << code.at(n % code.count());
+    }
+    else
+    {
+        QFile f(file);
+        QVERIFY(f.open(QFile::ReadOnly | QFile::Text));
+        lines = QString::fromUtf8(f.readAll()).split('\n');
+    }
+
+    Language lang(LANGUAGES + language);
+    SyntaxLexer lexer(lang);
+    QVector<SyntaxLexer::Span> spans;
+
+    QElapsedTimer timer;
+    timer.start();
+    int runs = 0;
+
+    QBENCHMARK {
+        int state = 0;
+        foreach (const QString & line, lines)
+        {
+            spans.resize(0);
+            state = lexer.lex(line, state, spans);
+        }
+        runs++;
+    }
+
+    qint64 elapsed = qMax(timer.elapsed(), (qint64) 1);
+    qDebug() << lines.count() << "lines," << (qint64) lines.count() * runs * 1000 / elapsed << "lines/second";
+}
+
+QTEST_GUILESS_MAIN(SpinParserBenchmark)
+#include "SpinParserBenchmark.moc"
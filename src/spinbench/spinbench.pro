@@ -0,0 +1,32 @@
+TEMPLATE = app
+TARGET = spinbench
+
+QT -= gui
+QT += testlib
+CONFIG += console
+CONFIG -= debug_and_release app_bundle
+
+INCLUDEPATH += ../propelleride
+
+DEFINES += LANGUAGES=\\\"$$PWD/../propelleride/languages/\\\"
+
+SOURCES += \
+    SpinParserBenchmark.cpp \
+    ../propelleride/SpinParser.cpp \
+    ../propelleride/SpinExpression.cpp \
+    ../propelleride/SpinFileResolver.cpp \
+    ../propelleride/SpinKeyword.cpp \
+    ../propelleride/SpinSymbolTable.cpp \
+    ../propelleride/SpinTokenizer.cpp \
+    ../propelleride/SyntaxLexer.cpp \
+    ../propelleride/Language.cpp \
+
+HEADERS += \
+    ../propelleride/SpinParser.h \
+    ../propelleride/SpinExpression.h \
+    ../propelleride/SpinFileResolver.h \
+    ../propelleride/SpinKeyword.h \
+    ../propelleride/SpinSymbolTable.h \
+    ../propelleride/SpinTokenizer.h \
+    ../propelleride/SyntaxLexer.h \
+    ../propelleride/Language.h \
@@ -0,0 +1,177 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSettings>
+
+#include "SpinParser.h"
+
+/*
+ * spinindex dumps the symbols and object tree of Spin projects
+ * without starting the IDE.
+ *
+ * All top files given are parsed by the same SpinParser, so objects
+ * shared between projects are only read once per run. Line and column
+ * numbers in the output start at 1.
+ */
+
+static QJsonObject projectJson(SpinParser & parser, QString file)
+{
+    QJsonObject project;
+    project["file"] = file;
+    project["files"] = QJsonArray::fromStringList(parser.spinFileList());
+
+    QJsonArray objects;
+    foreach (const SpinParser::ObjectNode & n, parser.spinObjectTree())
+    {
+        QJsonObject object;
+        object["node"] = n.node;
+        object["file"] = n.file;
+        objects.append(object);
+    }
+    project["objects"] = objects;
+
+    QJsonArray symbols;
+    SpinParser::SymbolList list = parser.spinSymbols("", "");
+    for (int n = 0; n < list.count(); n++)
+    {
+        QJsonObject symbol;
+        symbol["name"] = list.name(n);
+        symbol["kind"] = QString(list.kind(n));
+        symbol["file"] = list.file(n);
+        symbol["line"] = list.line(n)+1;
+        symbol["column"] = list.column(n)+1;
+        symbol["endLine"] = list.endLine(n)+1;
+        symbol["declaration"] = list.declaration(n);
+
+        QString value = parser.spinConstantValue(list.file(n), list.name(n), "");
+        if (!value.isEmpty())
+            symbol["value"] = value;
+        symbols.append(symbol);
+    }
+    project["symbols"] = symbols;
+
+    return project;
+}
+
+/* name<TAB>file<TAB>line;"<TAB>kind */
+static void appendTags(QStringList & tags, SpinParser & parser)
+{
+    SpinParser::SymbolList list = parser.spinSymbols("", "");
+    for (int n = 0; n < list.count(); n++)
+    {
+        tags.append(list.name(n) + "\t"
+                + list.file(n) + "\t"
+                + QString::number(list.line(n)+1) + ";\"\t"
+                + list.kind(n));
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    // share the library setting and symbol index with the IDE
+    QCoreApplication::setOrganizationName("Parallax");
+    QCoreApplication::setOrganizationDomain("www.parallax.com");
+    QCoreApplication::setApplicationName("PropellerIDE");
+
+    QCommandLineParser cmd;
+    cmd.setApplicationDescription("Dump the symbols and object tree of Spin projects.");
+    cmd.addHelpOption();
+
+    QCommandLineOption libraryOption(QStringList() << "l" << "library",
+            "Spin library path, the IDE setting if not given.", "path");
+    QCommandLineOption formatOption(QStringList() << "f" << "format",
+            "Output format, json or ctags.", "format", "json");
+    QCommandLineOption outputOption(QStringList() << "o" << "output",
+            "Write to file instead of standard output.", "file");
+
+    cmd.addOption(libraryOption);
+    cmd.addOption(formatOption);
+    cmd.addOption(outputOption);
+    cmd.addPositionalArgument("files", "Top object files to index.", "FILES...");
+    cmd.process(app);
+
+    QStringList files = cmd.positionalArguments();
+    if (files.isEmpty())
+        cmd.showHelp(1);
+
+    QString format = cmd.value(formatOption);
+    if (format != "json" && format != "ctags")
+    {
+        qCritical() << "unknown format" << format;
+        return 1;
+    }
+
+    QString library = cmd.isSet(libraryOption)
+        ? cmd.value(libraryOption)
+        : QSettings().value("Library").toString();
+
+    // the parser appends file names to the library path as they are
+    if (!library.isEmpty() && !library.endsWith("/"))
+        library += "/";
+
+    // the index of the IDE is read but left alone, it may be for another library
+    SpinParser parser;
+    parser.setIndexWritable(false);
+    QJsonArray projects;
+    QStringList tags;
+    int failed = 0;
+
+    foreach (QString file, files)
+    {
+        QFileInfo info(file);
+        if (!info.exists())
+        {
+            qWarning() << "can't find" << file;
+            failed++;
+            continue;
+        }
+
+        file = info.absoluteFilePath();
+        parser.spinFileTree(file, library);
+
+        if (format == "json")
+            projects.append(projectJson(parser, file));
+        else
+            appendTags(tags, parser);
+    }
+
+    QByteArray data;
+    if (format == "json")
+    {
+        data = QJsonDocument(projects).toJson();
+    }
+    else
+    {
+        tags.removeDuplicates();
+        tags.sort();
+        tags.prepend("!_TAG_FILE_SORTED\t1\t/0=unsorted, 1=sorted/");
+        tags.prepend("!_TAG_FILE_FORMAT\t2\t/extended format/");
+        data = tags.join("\n").toUtf8() + "\n";
+    }
+
+    QFile out;
+    if (cmd.isSet(outputOption))
+    {
+        out.setFileName(cmd.value(outputOption));
+        if (!out.open(QFile::WriteOnly))
+        {
+            qCritical() << "can't write" << out.fileName();
+            return 1;
+        }
+    }
+    else
+    {
+        out.open(stdout, QFile::WriteOnly);
+    }
+    out.write(data);
+    out.close();
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,26 @@
+TEMPLATE = app
+TARGET = spinindex
+target.path = $${PREFIX}/bin
+
+QT -= gui
+CONFIG += console
+CONFIG -= debug_and_release app_bundle
+
+INCLUDEPATH += ../propelleride
+
+SOURCES += \
+    main.cpp \
+    ../propelleride/SpinParser.cpp \
+    ../propelleride/SpinExpression.cpp \
+    ../propelleride/SpinFileResolver.cpp \
+    ../propelleride/SpinKeyword.cpp \
+    ../propelleride/SpinSymbolTable.cpp \
+    ../propelleride/SpinTokenizer.cpp \
+
+HEADERS += \
+    ../propelleride/SpinParser.h \
+    ../propelleride/SpinExpression.h \
+    ../propelleride/SpinFileResolver.h \
+    ../propelleride/SpinKeyword.h \
+    ../propelleride/SpinSymbolTable.h \
+    ../propelleride/SpinTokenizer.h \
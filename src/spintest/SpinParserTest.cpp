@@ -0,0 +1,183 @@
+#include <QtTest>
+#include <QFile>
+#include <QString>
+#include <QStringList>
+#include <QTemporaryDir>
+
+#include "SpinExpression.h"
+#include "SpinParser.h"
+#include "SpinTokenizer.h"
+
+/*
+ * Unit tests for the Spin parser.
+ *
+ * Built with CONFIG+=tests, run with make check.
+ */
+class SpinParserTest : public QObject
+{
+    Q_OBJECT
+
+private:
+    QTemporaryDir dir;
+
+    static QStringList tokens(const QString & text);
+    QString writeFile(const QString & name, const QString & text);
+
+private slots:
+    void tokenizerComments_data();
+    void tokenizerComments();
+
+    void datLabels_data();
+    void datLabels();
+
+    void expressions_data();
+    void expressions();
+};
+
+/* expressions without names, every name is unknown */
+class NoNames : public SpinExpression::Resolver
+{
+public:
+    SpinExpression::Value constant(const QString &, const QString &)
+    {
+        return SpinExpression::invalid();
+    }
+};
+
+/* the tokens of all lines, a line break in between lines */
+QStringList SpinParserTest::tokens(const QString & text)
+{
+    QStringList list;
+    SpinTokenizer t(text);
+    while (t.nextLine()) {
+        if (!list.isEmpty())
+            list << "\n";
+        for (int n = 0; n < t.count(); n++)
+            list << t.text(n).toString();
+    }
+    return list;
+}
+
+/* a file in the temporary directory, its path is returned */
+QString SpinParserTest::writeFile(const QString & name, const QString & text)
+{
+    QString fileName = dir.path() + "/" + name;
+    QFile file(fileName);
+    if (!file.open(QFile::WriteOnly | QFile::Truncate))
+        return QString();
+    file.write(text.toUtf8());
+    return fileName;
+}
+
+void SpinParserTest::tokenizerComments_data()
+{
+    QTest::addColumn<QString>("text");
+    QTest::addColumn<QStringList>("expected");
+
+    QTest::newRow("line")
+        << "a ' b { c"
+        << (QStringList() << "a");
+    QTest::newRow("block")
+        << "a { b } c"
+        << (QStringList() << "a" << "c");
+    QTest::newRow("block nested")
+        << "a { b { c } d } e"
+        << (QStringList() << "a" << "e");
+    QTest::newRow("block lines")
+        << "a {\nb\n} c"
+        << (QStringList() << "a" << "\n" << "c");
+    QTest::newRow("doc")
+        << "a {{ b }} c"
+        << (QStringList() << "a" << "c");
+    QTest::newRow("doc brace")
+        << "{{ see {x }}\nCON\n  x = 1"
+        << (QStringList() << "CON" << "\n" << "x" << "=" << "1");
+    QTest::newRow("doc close brace")
+        << "{{ a } b }} c"
+        << (QStringList() << "c");
+    QTest::newRow("doc nested")
+        << "{{ a {{ b }} c }} d"
+        << (QStringList() << "d");
+    QTest::newRow("block doc")
+        << "{ a {{ b } c"
+        << (QStringList() << "c");
+    QTest::newRow("string")
+        << "a \"{\" b"
+        << (QStringList() << "a" << "\"{\"" << "b");
+}
+
+void SpinParserTest::tokenizerComments()
+{
+    QFETCH(QString, text);
+    QFETCH(QStringList, expected);
+
+    QCOMPARE(tokens(text), expected);
+}
+
+void SpinParserTest::datLabels_data()
+{
+    QTest::addColumn<QString>("text");
+    QTest::addColumn<QStringList>("expected");
+
+    QTest::newRow("data")
+        << "DAT\nvalue long 1\nbuffer byte 0[16]\n"
+        << (QStringList() << "buffer" << "value");
+    QTest::newRow("instructions")
+        << "DAT\nentry mov a, #1\n      jmp #entry\n"
+        << (QStringList() << "entry");
+    QTest::newRow("conditions")
+        << "DAT\nloop  if_c_or_z jmp #loop\n      if_c_or_nz add a, #1\n"
+           "      if_nc_or_z sub a, #1\n      IF_NC_OR_NZ jmp #loop\n      if_z_or_c nop\n"
+        << (QStringList() << "loop");
+    QTest::newRow("reserved")
+        << "DAT\n      org 0\na     res 1\n      fit\n"
+        << (QStringList() << "a");
+}
+
+void SpinParserTest::datLabels()
+{
+    QFETCH(QString, text);
+    QFETCH(QStringList, expected);
+
+    QString fileName = writeFile(QString(QTest::currentDataTag()) + ".spin", text);
+    QVERIFY(!fileName.isEmpty());
+
+    SpinParser parser;
+    parser.setIndexWritable(false);
+    parser.spinFileTree(fileName, "");
+
+    QStringList labels;
+    SpinParser::SymbolList list = parser.spinDat("");
+    for (int n = 0; n < list.count(); n++)
+        labels << list.name(n);
+    labels.sort();
+
+    QCOMPARE(labels, expected);
+}
+
+void SpinParserTest::expressions_data()
+{
+    QTest::addColumn<QString>("expression");
+    QTest::addColumn<QString>("expected");
+
+    QTest::newRow("precedence")     << "1 + 2 * 3"          << "7";
+    QTest::newRow("divide")         << "-7 / 2"             << "-3";
+    QTest::newRow("divide by 0")    << "7 / 0"              << "";
+    QTest::newRow("modulus")        << "-7 // 3"            << "-1";
+    QTest::newRow("modulus by -1")  << "7 // -1"            << "0";
+    QTest::newRow("min modulus -1") << "$8000_0000 // -1"   << "0";
+    QTest::newRow("modulus by 0")   << "7 // 0"             << "";
+}
+
+void SpinParserTest::expressions()
+{
+    QFETCH(QString, expression);
+    QFETCH(QString, expected);
+
+    NoNames resolver;
+    QCOMPARE(SpinExpression::toString(SpinExpression::evaluate(expression, resolver)), expected);
+}
+
+QTEST_GUILESS_MAIN(SpinParserTest)
+
+#include "SpinParserTest.moc"
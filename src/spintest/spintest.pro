@@ -0,0 +1,26 @@
+TEMPLATE = app
+TARGET = spintest
+
+QT -= gui
+QT += testlib
+CONFIG += console testcase
+CONFIG -= debug_and_release app_bundle
+
+INCLUDEPATH += ../propelleride
+
+SOURCES += \
+    SpinParserTest.cpp \
+    ../propelleride/SpinParser.cpp \
+    ../propelleride/SpinExpression.cpp \
+    ../propelleride/SpinFileResolver.cpp \
+    ../propelleride/SpinKeyword.cpp \
+    ../propelleride/SpinSymbolTable.cpp \
+    ../propelleride/SpinTokenizer.cpp \
+
+HEADERS += \
+    ../propelleride/SpinParser.h \
+    ../propelleride/SpinExpression.h \
+    ../propelleride/SpinFileResolver.h \
+    ../propelleride/SpinKeyword.h \
+    ../propelleride/SpinSymbolTable.h \
+    ../propelleride/SpinTokenizer.h \
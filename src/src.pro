@@ -2,6 +2,13 @@ TEMPLATE  = subdirs
 
 SUBDIRS = \
     spinzip \
-    propelleride
+    propelleride \
+    spinindex
 
 propelleride.depends = spinzip
+
+# unit tests, qmake CONFIG+=tests && make check
+CONFIG(tests): SUBDIRS += spintest
+
+# parser benchmarks, qmake CONFIG+=bench, then run spinbench/spinbench
+CONFIG(bench): SUBDIRS += spinbench